@@ -14,11 +14,8 @@
   * 	-> Please contact Lenz Inc. for more details about XpressNet.
   *
   * not yet Supported:
-  *	- Emergency stop a locomotive: 0x92 AddrH AddrL [XOR]
-  *	- Emergency stop a locomotive: 0x91 loco_addr [XOR] (v2)
   *	- Service Mode: only direct Mode
   *	- DCC extended accessory command: 0x13 0x01 B+AddrH AddrL
-  *	- DCC FAST CLOCK: 0x01 0xF2 0xF3
   *	- Command Tunnel: 0x3* ** ** [XOR]
   *	- BiDi messages: 0x7* ** ** [XOR]
   *	- Library Entry: 0xE9 0xF1 AddrH AddrL IDX SIZE [NAME][XOR]
@@ -29,15 +26,136 @@
 // include this library's description file
 #include "XpressNetMaster.h"
 
+XpressNetMasterClass *XpressNetMasterClass::XNetFirstBus = NULL;	//Static
+
 #if defined(__AVR__)
 #include <avr/interrupt.h>
-XpressNetMasterClass *XpressNetMasterClass::active_object = 0;	//Static
+XpressNetMasterClass *XpressNetMasterClass::active_object[XNetMaxUART] = { NULL };	//Static
+
+//bits of the UART register, the same for all UARTs:
+#define XNetRXCIE 7		//UCSRnB
+#define XNetTXCIE 6
+#define XNetRXEN 4
+#define XNetTXEN 3
+#define XNetUCSZ2 2
+#define XNetRXB8 1
+#define XNetTXB8 0
+#define XNetUCSZ1 2		//UCSRnC
+#define XNetUCSZ0 1
+
+//UART register policy, each UART has its own type with the fixed register addresses:
+template<uint8_t UART> struct XNetUSART;
+#define XNetUSARTPolicy(n, A, B, C, L, H, D, Cmode) \
+	template<> struct XNetUSART<n> { \
+		static inline volatile uint8_t &UCSRnA(void) { return A; } \
+		static inline volatile uint8_t &UCSRnB(void) { return B; } \
+		static inline volatile uint8_t &UCSRnC(void) { return C; } \
+		static inline volatile uint8_t &UBRRnL(void) { return L; } \
+		static inline volatile uint8_t &UBRRnH(void) { return H; } \
+		static inline volatile uint8_t &UDRn(void) { return D; } \
+		static const uint8_t UCSRnCmode = Cmode; \
+	};
+
+#if defined(UCSR0A)
+XNetUSARTPolicy(0, UCSR0A, UCSR0B, UCSR0C, UBRR0L, UBRR0H, UDR0, 0)
+#elif defined(UCSRA)	//ATmega8, UCSRC and UBRRH share the address
+XNetUSARTPolicy(0, UCSRA, UCSRB, UCSRC, UBRRL, UBRRH, UDR, (1<<URSEL))
+#endif
+#if defined(UCSR1A)
+XNetUSARTPolicy(1, UCSR1A, UCSR1B, UCSR1C, UBRR1L, UBRR1H, UDR1, 0)
+#endif
+#if defined(UCSR2A)
+XNetUSARTPolicy(2, UCSR2A, UCSR2B, UCSR2C, UBRR2L, UBRR2H, UDR2, 0)
+#endif
+#if defined(UCSR3A)
+XNetUSARTPolicy(3, UCSR3A, UCSR3B, UCSR3C, UBRR3L, UBRR3H, UDR3, 0)
+#endif
+
+//62500 Baud, 9 bit, RX and TX interrupt
+template<uint8_t UART> static void XNetUSARTBegin(void) {
+	typedef XNetUSART<UART> U;
+	U::UBRRnH() = 0;
+	U::UBRRnL() = 0x0F;
+	U::UCSRnA() = 0;
+	U::UCSRnB() = (1<<XNetRXEN) | (1<<XNetTXEN) | (1<<XNetRXCIE) | (1<<XNetTXCIE) | (1<<XNetUCSZ2);
+	U::UCSRnC() = U::UCSRnCmode | (1<<XNetUCSZ1) | (1<<XNetUCSZ0);
+}
+
+//put the data into buffer, and send
+template<uint8_t UART> static void XNetUSARTWrite(uint16_t data9) {
+	typedef XNetUSART<UART> U;
+	if (data9 & 0x100) //is there a 9th bit?
+		U::UCSRnB() |= (1 << XNetTXB8);
+	else U::UCSRnB() &= ~(1 << XNetTXB8);
+	U::UDRn() = data9;
+}
+
+//filter the 9th bit first, then read the data
+template<uint8_t UART> static inline uint16_t XNetUSARTRead(void) {
+	typedef XNetUSART<UART> U;
+	uint16_t data9 = (U::UCSRnB() & (1 << XNetRXB8)) ? 0x100 : 0;
+	return data9 | U::UDRn();
+}
+
+#elif defined(XNetHardwareUART)
+#include "driver/uart.h"
+#include "hal/uart_ll.h"
+#include "soc/uart_periph.h"
+#include "esp_intr_alloc.h"
+#define XNetUARTHW UART_LL_GET_HW(XNetESP32UART)
 
-#elif defined(ESP8266) || defined(ESP32)
-#include <SoftwareSerial.h>
-SoftwareSerial XNetSwSerial;
 #endif
 
+#if defined(XNetHardwareUART)
+//RTS drives DE of the MAX485, RTS active (1) = LOW
+#define XNetSendMode() uart_ll_set_rts_active_level(XNetUARTHW, 0) 	//SEND_MODE
+#define XNetReceiveMode() do { uart_ll_set_rts_active_level(XNetUARTHW, 1); uart_ll_set_parity(XNetUARTHW, UART_PARITY_EVEN); } while (0)	//RECEIVE_MODE
+#else
+#define XNetSendMode() digitalWrite(MAX485_CONTROL, HIGH) 	//SEND_MODE
+#define XNetReceiveMode() digitalWrite(MAX485_CONTROL, LOW) 	//RECEIVE_MODE
+#endif
+
+//Cached reply frames in PROGMEM without the CallByte, the XOR is calculated by the compiler:
+static const uint8_t XNetFrameUnknown[] PROGMEM = { 0x61, 0x82, 0x61 ^ 0x82 };	//Befehl nicht vorhanden
+static const uint8_t XNetFrameTransferErr[] PROGMEM = { 0x61, 0x80, 0x61 ^ 0x80 };	//bertragungsfehler
+static const uint8_t XNetFrameVersion[] PROGMEM = { 0x63, 0x21, XNetVersion, XNetID, 0x63 ^ 0x21 ^ XNetVersion ^ XNetID };
+#define XNetStatusFrame(status) { 0x62, 0x22, (status), 0x62 ^ 0x22 ^ (status) }
+static const uint8_t XNetFrameStatusNormal[] PROGMEM = XNetStatusFrame(0x00);
+static const uint8_t XNetFrameStatusOff[] PROGMEM = XNetStatusFrame(0x01);
+static const uint8_t XNetFrameStatusShort[] PROGMEM = XNetStatusFrame(0x02);
+static const uint8_t XNetFrameStatusService[] PROGMEM = XNetStatusFrame(0x08);
+static const uint8_t XNetFrameFktStatus[] PROGMEM = { 0xE3, 0x50, 0x00, 0x00, 0xE3 ^ 0x50 };	//F0 bis F12 nicht tastend
+static const uint8_t XNetFrameFktStatusHigh[] PROGMEM = { 0xE3, 0x51, 0x00, 0x00, 0xE3 ^ 0x51 };	//F13 bis F28 nicht tastend
+static const uint8_t XNetFrameProgBusy[] PROGMEM = { 0x61, 0x1F, 0x61 ^ 0x1F };	//Programmierinfo "Zentrale busy"
+static const uint8_t XNetFrameProgNack[] PROGMEM = { 0x61, 0x13, 0x61 ^ 0x13 };	//Programmierinfo "Daten nicht gefunden"
+static const uint8_t XNetFrameProgShort[] PROGMEM = { 0x61, 0x12, 0x61 ^ 0x12 };	//Programmierinfo "Kurzschluss"
+static const uint8_t XNetFramePowerOn[] PROGMEM = { 0x61, 0x01, 0x61 ^ 0x01 };
+static const uint8_t XNetFramePowerOff[] PROGMEM = { 0x61, 0x00, 0x61 ^ 0x00 };
+static const uint8_t XNetFramePowerShort[] PROGMEM = { 0x61, 0x08, 0x61 ^ 0x08 };
+static const uint8_t XNetFramePowerService[] PROGMEM = { 0x61, 0x02, 0x61 ^ 0x02 };
+static const uint8_t XNetFramePowerEStop[] PROGMEM = { 0x81, 0x00, 0x81 ^ 0x00 };
+	//SLAVE MODE:
+static const uint8_t XNetFrameReqPowerOn[] PROGMEM = { 0x21, 0x81, 0x21 ^ 0x81 };
+static const uint8_t XNetFrameReqPowerOff[] PROGMEM = { 0x21, 0x80, 0x21 ^ 0x80 };
+static const uint8_t XNetFrameReqEStop[] PROGMEM = { 0x80, 0x80 };
+static const uint8_t XNetFrameReqVersion[] PROGMEM = { 0x21, 0x21, 0x21 ^ 0x21 };
+static const uint8_t XNetFrameReqStatus[] PROGMEM = { 0x21, 0x24, 0x21 ^ 0x24 };
+static const uint8_t XNetFrameAck[] PROGMEM = { 0x20, 0x20 };
+
+//Databyte1 of the function groups 1..10
+static const uint8_t XNetFuncCmd[] PROGMEM = { 0x20, 0x21, 0x22, 0x23, 0x28, 0x29, 0x2A, 0x2B, 0x50, 0x51 };
+#define XNetFuncMask(Group) ((Group) == 1 ? 0x1F : ((Group) <= 3 ? 0x0F : 0xFF))	//used bits of the group
+#define XNetTrntNibble(Module, N) ((((N) & 0x01) << 4) | ((XNetTrnt[Module] >> (((N) & 0x01) * 4)) & 0x0F))	//ITTN ZZZZ out of the turnout store
+#define XNetTrntOwn(Module) ((uint16_t)((Module) - XNetTrntFirst) < XNetTrntCount)	//turnout decoder, answered out of the store
+#define XNetFBRoom() ((XNetSlaveMode == 0x00) ? (XNetTXBuffer.msg[XNetTXBuffer.get].length == 0x00) : !XNetTXFull())	//MASTER MODE: one feedback paket between the windows
+#define XNetSlotUsed(Slot) ((SlotLokUse[Slot] != 0xFFFF) || (SlotActivity[Slot] > 0))	//a device was seen on this slot
+
+//send a cached frame, the CallByte is added:
+#define XNetSlaveOwn(CallByte, Type) ((((CallByte) & 0x60) == (Type)) && ((XNetSlaveMask >> ((CallByte) & 0x1F)) & 0x01) && (callByteParity((CallByte) & 0x7F) == (CallByte)))	//SLAVE MODE: CallByte for one of our devices
+#define XNetsendCached(CallByte, frame) XNetsendFrame((CallByte), (frame), sizeof(frame) + 1)
+#define XNetsendCachedPrio(CallByte, frame) XNetsendPrio((CallByte), (frame), sizeof(frame) + 1)
+#define XNetsendCachedReply(CallByte, frame) XNetsendReply((CallByte), (frame), sizeof(frame) + 1)
+
 // Constructor /////////////////////////////////////////////////////////////////
 // Function that handles the creation and setup of instances
 
@@ -45,7 +163,14 @@ XpressNetMasterClass::XpressNetMasterClass()
 {
 	// initialize this instance's variables 
 	XNetAdr = 0;	//Startaddresse des ersten XNet Device
+	XSendCount = 0;
+	CallByteInquiry = 0;
+	RequestAck = 0;
+	DirectedOps = 0;
+	XNetReplay = false;
+	#if defined(XNetSlaveSupport)
 	XNetSlaveMode = 0;	//Start in MASTER MODE
+	#endif
 	XNetSlaveInit = 0;		//for init state in Slave Mode
 	XModeAuto = true;		//Automatische Umschaltung Master/Slave Mode aktiv
 	Railpower = csNormal;
@@ -53,32 +178,147 @@ XpressNetMasterClass::XpressNetMasterClass()
 	
 	for (byte s = 0; s < 32; s++) { //clear busy slots
 		SlotLokUse[s] = 0xFFFF;	//slot is inactiv
+		SlotActivity[s] = 0;	//no paket received
 	}
+	XNetRX.data = XNetRXBuffer.msg[0].data;
+	#if defined(XNetSlaveSupport)
+	XNetSlaveMask = 1UL << (MY_ADDRESS & 0x1F);	//SLAVE MODE device address
+	XNetSlaveCall = MY_ADDRESS & 0x1F;
+	XNetSlaveTag = 0x00;	//send in any window
+	XNetSlaveReqCount = 0;	//no loco request in SLAVE MODE
+	XNetSlaveReqSent = false;
+	XNetSlaveReqTime = 0;
+	#endif
+	#if defined(XNetPowerSave)
+	XNetPowerSaveOn = false;	//full rate after the start
+	XNetPowerSaveTime = 0;
+	#endif
+	#if defined(XNetBusyTracker)
+	for (byte i = 0; i < XNetOwnerSize; i++)
+		XNetOwner[i] = 0;	//no loco in use
+	#endif
+	XNetActiveAdr = 0;
+	XNetActiveTurn = 0;
+	XNetRound = 0;		//start with a discovery round
+	XNetActiveTick = 0;
 	
 	XNetTXBuffer.get = 0;	//start position to read data from the buffer
 	XNetTXBuffer.pos = 0;	//position of byte that we are sending
 	XNetTXBuffer.put = 0; //start position to store data in buffer
+	XNetTXPrio.get = 0;
+	XNetTXPrio.pos = 0;	//not used, the position is in XNetTXBuffer.pos
+	XNetTXPrio.put = 0;
+	XNetTXMsg = NULL;	//no message in progress
+	XNetTXReply.length = 0x00;
+	XNetTXReply.frame = NULL;
+	XNetPrioLatency = 0;
 	
 	XNetRXBuffer.get = 0;	//start position to read data from the buffer
 	XNetRXBuffer.pos = 0;	//position of byte that we are sending
 	XNetRXBuffer.put = 0; //start position to store data in buffer
 	
-	for (byte b = 0; b < XNetBufferSize; b++) {	//clear send buffer
+	for (byte b = 0; b < XNetTXBufferSize; b++) {	//clear send buffer
 		XNetTXBuffer.msg[b].length = 0x00;
-		XNetRXBuffer.msg[b].length = 0x00;
-		for (byte d = 0; d < XNetBufferMaxData; d++) {
+		XNetTXBuffer.msg[b].frame = NULL;
+		for (byte d = 0; d < XNetBufferMaxData; d++) 
 			XNetTXBuffer.msg[b].data[d] = 0x00;
+	}
+	for (byte b = 0; b < XNetTXPrioSize; b++) {	//clear priority send buffer
+		XNetTXPrio.msg[b].length = 0x00;
+		XNetTXPrio.msg[b].frame = NULL;
+	}
+	for (byte b = 0; b < XNetRXBufferSize; b++) {	//clear read buffer
+		XNetRXBuffer.msg[b].length = 0x00;
+		XNetRXBuffer.msg[b].frame = NULL;
+		for (byte d = 0; d < XNetBufferMaxData; d++)
 			XNetRXBuffer.msg[b].data[d] = 0x00;
-		}
 	}
+	XNetTXOverrun = 0;
+	XNetRXOverrun = 0;
+	#if defined(XNetHardwareUART)
+	XNetRXResyncs = 0;
+	XNetRXDrop = false;
+	#endif
+	XNetRXSync = 0;
+	XNetRXXor = 0;
+	XNetRXNeed = 0;
+	XNetTXBusy = false;
 	
-	XNetCVAdr = 0;	//no CV read
-	XNetCVvalue = 0;	//no CV value
+	XNetWindowOpen = false;
+	XNetWindowTime = 0;
+	XNetCallWait = false;
+	XNetTXLast = 0;
+	
+	#if (XNetFeedbackBuffer > 0)
+	XNetFBCount = 0;	//no feedback to send
+	#endif
+	
+	#if defined(XNetLocoCache)
+	clearLocoCache(0);
+	#endif
+	
+	#if defined(XNetStatistics)
+	clearStats();
+	#endif
+	
+	#if defined(XNetTrace)
+	XNetTracePut = 0;
+	XNetTraceGet = 0;
+	XNetTraceTime = 0;
+	XNetTraceLost = 0;
+	#endif
+	
+	#if defined(XNetServiceMode)
+	for (uint8_t i = 0; i < XNetCVJobs; i++)
+		XNetCVList[i].state = XNetCVFree;	//no CV programming
+	XNetCVActive = NULL;
+	#endif
+	
+	#if defined(XNetTrntStore)
+	for (uint16_t i = 0; i < (XNetTrntStore / 4); i++)
+		XNetTrnt[i] = 0x00;	//position unknown
+	XNetTrntFirst = 0;
+	XNetTrntCount = 0;	//the sketch set the turnout decoders
+	#endif
+	
+	#if defined(XNetFastClock)
+	for (uint8_t i = 0; i < 4; i++)
+		XNetClock[i] = 0;	//Monday 0:00, clock stop
+	XNetClockNext = 0;
+	XNetClockRest = 0;
+	XNetClockDue = false;
+	#endif
+	
+	XNetNextBus = XNetFirstBus;	//add to the list of all bus
+	XNetFirstBus = this;
+}
+
+//--------------------------------------------------------------------------------------------
+XpressNetMasterClass::~XpressNetMasterClass()
+{
+	#if defined(__AVR__)
+	for (byte u = 0; u < XNetMaxUART; u++) {
+		if (active_object[u] == this)
+			active_object[u] = NULL;	//no more interrupts for this object
+	}
+	#endif
+	XpressNetMasterClass **bus = &XNetFirstBus;
+	while (*bus != NULL) {
+		if (*bus == this) {
+			*bus = XNetNextBus;	//remove from the list of all bus
+			break;
+		}
+		bus = &(*bus)->XNetNextBus;
+	}
 }
 
 //******************************************Serial*******************************************
-#if defined(ESP8266) || defined(ESP32)
+#if defined(XNetHardwareUART)
+void XpressNetMasterClass::setup(uint8_t FStufen, uint8_t XNetRxPin, uint8_t XNetTxPin, uint8_t XControl, bool XnModeAuto)  //Initialisierung UART
+#elif defined(ESP8266) || defined(ESP32)
 void XpressNetMasterClass::setup(uint8_t FStufen, uint8_t  XNetPort, uint8_t  XControl, bool XnModeAuto)  //Initialisierung Serial
+#elif defined(__AVR__)
+void XpressNetMasterClass::setup(uint8_t FStufen, uint8_t  XControl, bool XnModeAuto, uint8_t UART)  //Initialisierung Serial
 #else
 void XpressNetMasterClass::setup(uint8_t FStufen, uint8_t  XControl, bool XnModeAuto)  //Initialisierung Serial
 #endif
@@ -86,8 +326,10 @@ void XpressNetMasterClass::setup(uint8_t FStufen, uint8_t  XControl, bool XnMode
 	Fahrstufe = FStufen;
 	MAX485_CONTROL = XControl;
 	XModeAuto = XnModeAuto;
+	#if defined(XNetSlaveSupport)
 	if (XnModeAuto == false) //change to SLAVE MODE ONLY?
 		XNetSlaveMode = XNetSlaveCycle;	//reactivate SLAVE MODE
+	#endif
 	
 	// LISTEN_MODE 
 	pinMode(MAX485_CONTROL, OUTPUT);
@@ -97,25 +339,24 @@ void XpressNetMasterClass::setup(uint8_t FStufen, uint8_t  XControl, bool XnMode
 
 	//Set up on 62500 Baud
 	cli();  //disable interrupts while initializing the USART
-	#if defined(__AVR_ATmega328p__)
-	 UBRRH = 0;
-	 UBRRL = 0x0F;
-	 UCSRA = 0;
-	 UCSRB = (1<<RXEN) | (1<<TXEN) | (1<<RXCIE) | (1<<TXCIE) | (1<<UCSZ2);
-	 UCSRC = (1<<UCSZ1) | (1<<UCSZ0);
-	#elif defined(SERIAL_PORT_0)
-	 UBRR0H = 0;
-	 UBRR0L = 0x0F;
-	 UCSR0A = 0;
-	 UCSR0B = (1<<RXEN0) | (1<<TXEN0) | (1<<RXCIE0) | (1<<TXCIE0)| (1<<UCSZ02);
-	 UCSR0C = (1<<UCSZ01) | (1<<UCSZ00);
-	#else
-	 UBRR1H = 0;
-	 UBRR1L = 0x0F;
-	 UCSR1A = 0;
-	 UCSR1B = (1<<RXEN1) | (1<<TXEN1) | (1<<RXCIE1) | (1<<TXCIE1) | (1<<UCSZ12);
-	 UCSR1C = (1<<UCSZ11) | (1<<UCSZ10);
-	#endif 
+	switch (UART) {
+	#if defined(UCSR1A)
+	 case 1: XNetUSARTBegin<1>(); XNetUARTWrite = XNetUSARTWrite<1>; break;
+	#endif
+	#if defined(UCSR2A)
+	 case 2: XNetUSARTBegin<2>(); XNetUARTWrite = XNetUSARTWrite<2>; break;
+	#endif
+	#if defined(UCSR3A)
+	 case 3: XNetUSARTBegin<3>(); XNetUARTWrite = XNetUSARTWrite<3>; break;
+	#endif
+	 default: 
+	#if defined(UCSR0A) || defined(UCSRA)
+	 UART = 0; XNetUSARTBegin<0>(); XNetUARTWrite = XNetUSARTWrite<0>;
+	#else	//only UART1 (ATmega32U4)
+	 UART = 1; XNetUSARTBegin<1>(); XNetUARTWrite = XNetUSARTWrite<1>;
+	#endif
+	}
+	 active_object[UART] = this;		//hold Object to call it back in ISR
 	 sei(); // Enable the Global Interrupt Enable flag so that interrupts can be processed 
 	 /*
 	 *  Enable reception (RXEN = 1).
@@ -125,9 +366,26 @@ void XpressNetMasterClass::setup(uint8_t FStufen, uint8_t  XControl, bool XnMode
 	 *  Set 9-bit character mode (UCSZ00, UCSZ01, and UCSZ02 together control this, 
 	 *  But UCSZ00, UCSZ01 are in Register UCSR0C).
 	 */
-	active_object = this;		//hold Object to call it back in ISR
 	 
-#elif defined(ESP8266) || defined(ESP32) 
+#elif defined(XNetHardwareUART)
+	//62500 Baud 8E1, the parity bit is switched for each byte to send the 9th bit
+	uart_config_t config = {};
+	config.baud_rate = 62500;
+	config.data_bits = UART_DATA_8_BITS;
+	config.parity = UART_PARITY_EVEN;
+	config.stop_bits = UART_STOP_BITS_1;
+	config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+	uart_param_config((uart_port_t)XNetESP32UART, &config);
+	uart_set_pin((uart_port_t)XNetESP32UART, XNetTxPin, XNetRxPin, MAX485_CONTROL, UART_PIN_NO_CHANGE);	//DE/RE on RTS
+	XNetReceiveMode();
+	
+	uart_ll_set_rxfifo_full_thr(XNetUARTHW, 1);	//interrupt for each byte, to read the parity error of this byte
+	uart_ll_disable_intr_mask(XNetUARTHW, UART_LL_INTR_MASK);
+	uart_ll_clr_intsts_mask(XNetUARTHW, UART_LL_INTR_MASK);
+	esp_intr_alloc(uart_periph_signal[XNetESP32UART].irq, 0, XpressNetMasterClass::handle_UART_interrupt, this, NULL);
+	uart_ll_ena_intr_mask(XNetUARTHW, UART_INTR_RXFIFO_FULL | UART_INTR_PARITY_ERR | UART_INTR_TX_DONE);
+	
+#elif defined(XNetSoftwareSerial)
 	XNetSwSerial.begin(62500, SWSERIAL_8S1, XNetPort, XNetPort, false, 95); //One Wire Half Duplex Serial, parity mode SPACE
 	if (!XNetSwSerial) { // If the object did not initialize, then its configuration is invalid
 		Serial.println("Invalid SoftwareSerial pin configuration, check config"); 
@@ -161,41 +419,26 @@ bool XpressNetMasterClass::update(void)
 {
 	bool status = false; 		//nothing to do!
 	
-	#if defined(ESP8266) || defined(ESP32)
+	#if defined(XNetSoftwareSerial)
 	//Check if we have data available for receive:
 	XNetReceive();	
 	#endif
 	
+	#if (XNetFeedbackBuffer > 0)
+	if (XNetFBCount > 0)
+		XNetFeedbackFlush();	//send the feedback of the last cycle, what is left waits
+	#endif
+	
 	//check if have some receive data in our buffer to decode:
-	if (XNetRXBuffer.get != XNetRXBuffer.put) {
+	if (XNetRXDecode()) {
 			status = true;		//work on a packet!
-			#if defined (XNetDEBUGTime)
-			XNetSerial.print(XNetRXBuffer.put);
-			XNetSerial.print("r");
-			XNetSerial.print(XNetRXBuffer.get);
-			XNetSerial.print(" Paket time: ");
-			XNetSerial.print(micros() - XSendCount);
-			#endif
-			//XNetDataReady = false;
-			if (XNetCheckXOR())	{ //Checks the XOR
-				#if defined (XNetDEBUGTime)
-				XNetSerial.println(" OK");
-				#endif
-				XNetAnalyseReceived();	//Auswerten der empfangenen Daten
-			}
-						
-			XNetRXclear(XNetRXBuffer.get);	//alte Nachricht lschen
-			
-			XNetRXBuffer.get++;
-			if (XNetRXBuffer.get >= XNetBufferSize)	//overflow?
-				XNetRXBuffer.get = 0;	//start from the first value
-			
 			if (XNetSlaveMode == 0x00) {		//MASTER MODE
-				XNetSendData();	//start sending an answer
+				XNetTXStart();	//start sending an answer
 		
 				//Start next Transmission Window direct after receive!
-				getNextXNetAdr();	//Send next CallByte
-				XNetSendData();	//start sending out by interrupt
+				if (!XNetCallWait)	//only one CallByte in the Send Buffer
+					getNextXNetAdr();	//Send next CallByte
+				XNetTXStart();	//start sending out by interrupt
 				XSendCount = micros(); //save time last Data on Bus!
 				XNetSlaveInit = 0;	//reset the init prozess for slave Mode
 			
@@ -203,19 +446,58 @@ bool XpressNetMasterClass::update(void)
 	}
 	
 	if (XNetSlaveMode == 0x00) {		//MASTER MODE
-		if (  (micros() - XSendCount) > XNetTransmissionWindow) {
-			XNetRXclear(XNetRXBuffer.put);	//alte Nachricht lschen
-			getNextXNetAdr();	//Send next CallByte
-			XNetSendData();	//start sending out by interrupt
+		#if defined(XNetServiceMode)
+		XNetCVUpdate();	//CV programming timeouts and next job
+		#endif
+		#if defined(XNetFastClock)
+		XNetClockUpdate();
+		#endif
+		#if defined(XNetPowerSave)
+		if (!XNetPowerSaveOn && ((millis() - XNetPowerSaveTime) > XNetPowerSave)) {
+			XNetPowerSaveOn = true;
+			for (byte s = 0; s < 32; s++) {
+				if (SlotLokUse[s] != 0 && SlotLokUse[s] != 0xFFFF) {	//a loco is in use
+					XNetPowerSaveOn = false;
+					XNetPowerSaveTime = millis();	//check again later
+					break;
+				}
+			}
+			if (XNetPowerSaveOn)
+				XNetRound = 0;	//call all slots from now on
+		}
+		#endif
+		
+		bool NextSlot = (micros() - XSendCount) > XNetTransmissionWindow;
+		#if defined (XNetFastAdvance)
+		if (XNetWindowOpen && ((micros() - XNetWindowTime) > XNetResponseTimeout))
+			NextSlot = true;	//device is silent, don't wait the full window
+		#endif
+		#if defined(XNetPowerSave)
+		if (XNetPowerSaveOn)
+			NextSlot = (micros() - XSendCount) > XNetPowerSavePoll;	//slow polling
+		#endif
+		if (NextSlot) {
+			#if defined(XNetStatistics)
+			if (XNetWindowOpen)	//no answer in the window
+				XNetStat.slot[DirectedOps & 0x1F].timeouts++;
+			#endif
+			XNetWindowOpen = false;
+			#if defined(XNetFastClock)
+			if (XNetClockDue && !XNetCallWait && XNetTXBuffer.msg[XNetTXBuffer.get].length == 0x00)
+				XNetSendClock(GENERAL_BROADCAST);	//the bus is free, no device has answered
+			#endif
+			if (!XNetCallWait)	//only one CallByte in the Send Buffer
+				getNextXNetAdr();	//Send next CallByte, clear the old message
+			XNetTXStart();	//start sending out by interrupt
 			XSendCount = micros(); //save time last Data on Bus!
 			XNetSlaveInit = 0;	//reset the init prozess for slave Mode
 		}
 	}
+	#if defined(XNetSlaveSupport)
 	else {
 		if (XNetSlaveInit == 0) {
 				XNetSlaveInit = 1;
-				uint8_t Init[] = { 0x00, 0x21, 0x21, 0x00 };	
-				XNetsend(Init, 4);	//send initsequence
+				XNetsendCached(0x00, XNetFrameReqVersion);	//send initsequence
 				#if defined (XNetDEBUG)
 				XNetSerial.print("Slave INIT: ");
 				XNetSerial.println(XNetSlaveMode);
@@ -229,21 +511,112 @@ bool XpressNetMasterClass::update(void)
 			if (XModeAuto && (XNetSlaveMode > 0))
 				XNetSlaveMode--;	//stay only in SLAVE MODE if we receive CallBytes
 		}
-		if (XNetTXBuffer.put != XNetTXBuffer.get)
+		XNetSlaveReqUpdate();	//next loco request, timeouts
+		if ((XNetTXBuffer.put != XNetTXBuffer.get) || (XNetTXPrio.put != XNetTXPrio.get))
 			status = true;
 	}
+	#endif
+	
+	if (!status && notifyXNetIdle) {	//nothing to do, give the time to the sketch
+		unsigned long budget = timeUntilNextDeadline();
+		if (budget >= XNetIdleMin)
+			notifyXNetIdle(budget);
+	}
 	return status;
 }
 
+#if defined(XNetPowerSave)
+//--------------------------------------------------------------------------------------------
+//slow polling is active, the sketch can sleep for timeUntilNextDeadline()
+bool XpressNetMasterClass::getPowerSave(void) {
+	return XNetPowerSaveOn;
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+//time in s until update() must work again, the next CallByte or the end of the response time
+//a paket received before is still decoded late, only the receive interrupt answer it direct
+unsigned long XpressNetMasterClass::timeUntilNextDeadline(void) {
+	if (XNetRXBuffer.get != XNetRXBuffer.put)
+		return 0;	//paket waits for decode
+	#if (XNetFeedbackBuffer > 0)
+	if (XNetFBCount > 0 && XNetFBRoom())
+		return 0;	//feedback can be send now
+	#endif
+	unsigned long now = micros();
+	unsigned long pass = now - XSendCount;
+	if (XNetSlaveMode != 0x00) {	//SLAVE MODE: the Central Station call us, only the mode check
+		if (pass >= 2000)
+			return 0;
+		return 2000 - pass;
+	}
+	#if defined(XNetPowerSave)
+	if (XNetPowerSaveOn) {	//time to sleep
+		if (pass >= XNetPowerSavePoll)
+			return 0;
+		return XNetPowerSavePoll - pass;
+	}
+	#endif
+	if (pass >= XNetTransmissionWindow)
+		return 0;	//next CallByte
+	unsigned long left = XNetTransmissionWindow - pass;
+	#if defined (XNetFastAdvance)
+	if (XNetWindowOpen) {	//the device can be silent
+		pass = now - XNetWindowTime;
+		if (pass >= XNetResponseTimeout)
+			return 0;
+		if ((XNetResponseTimeout - pass) < left)
+			left = XNetResponseTimeout - pass;
+	}
+	else if (XNetCallWait && (XNetByteTime + XNetResponseTimeout) < left)
+		left = XNetByteTime + XNetResponseTimeout;	//the CallByte is not out, the window begins after it
+	#endif
+	return left;
+}
+
+//--------------------------------------------------------------------------------------------
+//decode the next received paket, false = the Read Buffer is empty
+bool XpressNetMasterClass::XNetRXDecode(void) {
+	if (XNetRXBuffer.get == XNetRXBuffer.put)
+		return false;
+	XNetBarrier();	//read the message after it was published
+	#if defined (XNetDEBUGTime)
+	XNetSerial.print(XNetRXBuffer.put);
+	XNetSerial.print("r");
+	XNetSerial.print(XNetRXBuffer.get);
+	XNetSerial.print(" Paket time: ");
+	XNetSerial.print(micros() - XSendCount);
+	#endif
+	//XNetDataReady = false;
+	if (XNetCheckXOR())	{ //Checks the XOR
+		#if defined (XNetDEBUGTime)
+		XNetSerial.println(" OK");
+		#endif
+		if (XNetSlaveMode == 0x00) {		//MASTER MODE
+			SlotActivity[DirectedOps & 0x1F] = XNetActiveTime;	//call this slot more often
+			#if defined(XNetPowerSave)
+			XNetPowerSaveOn = false;	//back to the full rate
+			XNetPowerSaveTime = millis();
+			#endif
+			#if defined(XNetStatistics)
+			XNetStat.slot[DirectedOps & 0x1F].answers++;
+			#endif
+		}
+		XNetAnalyseReceived();	//Auswerten der empfangenen Daten
+	}
+
+	XNetRXclear(XNetRXBuffer.get);	//alte Nachricht lschen
+
+	XNetBarrier();	//release the message before we move on
+	XNetRXBuffer.get = (XNetRXBuffer.get + 1) & XNetRXBuffer.mask;	//next, start from the first value at the end
+	return true;
+}
+
 //--------------------------------------------------------------------------------------------
 //Checks the XOR
 bool XpressNetMasterClass::XNetCheckXOR(void) {
 	
-	byte rxXOR = 0x00;			//store the read in XOR
-	for (byte i = 0; i < ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetheader] & 0x0F) + 2); i++) {
-		rxXOR = rxXOR ^ XNetRXBuffer.msg[XNetRXBuffer.get].data[i+1];	//jump over CallByte
-	}
-	if (rxXOR == 0x00) {	//XOR is 0x00!
+	if (XNetRXBuffer.msg[XNetRXBuffer.get].xorOK) {	//XOR is 0x00, checked while receive
 		return true;
 	}
 	
@@ -261,563 +634,729 @@ bool XpressNetMasterClass::XNetCheckXOR(void) {
 	#endif
 	
 	
-	//bertragungsfehler:
-	if (XNetSlaveMode == 0x00) {		//MASTER MODE
-		uint8_t ERR[] = {DirectedOps, 0x61, 0x80, 0xE1 };	
-		XNetsend(ERR, 4);
-	}
+	//bertragungsfehler, the receive has already send it out:
+	#if defined(XNetStatistics)
+	if (XNetSlaveMode == 0x00)		//MASTER MODE
+		XNetStat.slot[DirectedOps & 0x1F].xorFails++;
+	#endif
 	return false;
 }
 
+//--------------------------------------------------------------------------------------------
+//Dispatch tables, sorted by Header and Databyte1 (cmd)!
+const XNetDispatch XpressNetMasterClass::XNetMasterTable[] PROGMEM = {
+	// header, cmd, flags, param, handler
+	#if defined(XNetFastClock)
+	{ 0x01, 0xF2, XNetOnlyMaster | XNetMarkSlot, 0, &XpressNetMasterClass::XNetRxClock },	//DCC FAST CLOCK request
+	#endif
+	#if defined(XNetServiceMode)
+	{ 0x21, 0x10, XNetOnlyMaster | XNetMarkSlot, 0, &XpressNetMasterClass::XNetRxCVResult },	//Request for Service Mode results
+	#endif
+	{ 0x21, 0x21, XNetOnlyMaster | XNetMarkSlot, 0, &XpressNetMasterClass::XNetRxVersion },	//Command station softwareversion
+	{ 0x21, 0x24, XNetOnlyMaster | XNetMarkSlot, 0, &XpressNetMasterClass::XNetRxStatus },	//Command station status
+	{ 0x21, 0x80, XNetOnlyMaster | XNetMarkSlot, csTrackVoltageOff, &XpressNetMasterClass::XNetRxPower },	//Alles Aus (Notaus)
+	{ 0x21, 0x81, XNetOnlyMaster | XNetMarkSlot, csNormal, &XpressNetMasterClass::XNetRxPower },	//Alles An
+	{ 0x21, XNetAnyCmd, XNetOnlyMaster | XNetMarkSlot, 0, &XpressNetMasterClass::XNetRxNone },
+	#if defined(XNetServiceMode)
+	{ 0x22, 0x15, 0, 0, &XpressNetMasterClass::XNetRxCVRead },	//Direct Mode CV read request (CV mode)
+	{ 0x23, 0x16, 0, 0, &XpressNetMasterClass::XNetRxCVWrite },	//Direct Mode CV write request (CV mode)
+	#endif
+	{ 0x42, XNetAnyCmd, XNetOnlyMaster, 0, &XpressNetMasterClass::XNetRxTrntInfo },	//Accessory Decoder information request
+	{ 0x43, XNetAnyCmd, XNetOnlyMaster, 1, &XpressNetMasterClass::XNetRxTrntInfo },	//Accessory Decoder >1024 information request
+	{ 0x52, XNetAnyCmd, 0, 0, &XpressNetMasterClass::XNetRxTrnt },	//Accessory Decoder operation request
+	{ 0x53, XNetAnyCmd, 0, 1, &XpressNetMasterClass::XNetRxTrnt },	//Accessory Decoder >1024 operation request
+	{ 0x80, 0x80, 0, csEmergencyStop, &XpressNetMasterClass::XNetRxPower },	//EmStop
+	{ 0x91, XNetAnyCmd, 0, 0, &XpressNetMasterClass::XNetRxLocoEmStop },	//Emergency stop a locomotive (v2)
+	{ 0x92, XNetAnyCmd, 0, 1, &XpressNetMasterClass::XNetRxLocoEmStop },	//Emergency stop a locomotive
+	{ 0xE3, 0x00, XNetOnlyMaster, 0, &XpressNetMasterClass::XNetRxLocoInfo },	//Lokdaten anfordern & F0 bis F12 anfordern
+	{ 0xE3, 0x07, XNetOnlyMaster, 0x50, &XpressNetMasterClass::XNetRxFktMode },	//Funktionsstatus F0 bis F12 anfordern
+	#if defined(XNetExtFunctions)
+	{ 0xE3, 0x08, XNetOnlyMaster, 0x51, &XpressNetMasterClass::XNetRxFktMode },	//Funktionsstatus F13 bis F28 anfordern
+	{ 0xE3, 0x09, XNetOnlyMaster, 0, &XpressNetMasterClass::XNetRxLocoFunc },	//Funktionszustand F13 bis F28 anfordern
+	#endif
+	{ 0xE3, 0xF0, XNetOnlyMaster, 0, &XpressNetMasterClass::XNetRxLocoMM },	//Lok und Funktionszustand MultiMaus anfordern
+	{ 0xE3, XNetAnyCmd, XNetOnlyMaster, 0, &XpressNetMasterClass::XNetRxUnknown },
+	{ 0xE4, 0x10, 0, Loco14, &XpressNetMasterClass::XNetRxDrive },	//14 Fahrstufen
+	{ 0xE4, 0x11, 0, Loco27, &XpressNetMasterClass::XNetRxDrive },	//27 Fahrstufen
+	{ 0xE4, 0x12, 0, Loco28, &XpressNetMasterClass::XNetRxDrive },	//28 Fahrstufen
+	{ 0xE4, 0x13, 0, Loco128, &XpressNetMasterClass::XNetRxDrive },	//128 Fahrstufen
+	{ 0xE4, 0x20, 0, 1, &XpressNetMasterClass::XNetRxFunc },	//Funktionsbefehl Gruppe1 0 0 0 F0 F4 F3 F2 F1
+	{ 0xE4, 0x21, 0, 2, &XpressNetMasterClass::XNetRxFunc },	//Funktionsbefehl Gruppe2 0000 F8 F7 F6 F5
+	{ 0xE4, 0x22, 0, 3, &XpressNetMasterClass::XNetRxFunc },	//Funktionsbefehl Gruppe3 0000 F12 F11 F10 F9
+	#if defined(XNetExtFunctions)
+	{ 0xE4, 0x23, 0, 4, &XpressNetMasterClass::XNetRxFunc },	//Funktionsbefehl Gruppe4 F20-F13
+	{ 0xE4, 0x28, 0, 5, &XpressNetMasterClass::XNetRxFunc },	//Funktionsbefehl Gruppe5 F28-F21
+	{ 0xE4, 0x29, 0, 6, &XpressNetMasterClass::XNetRxFunc },	//Funktionsbefehl Gruppe6 F36-F29
+	{ 0xE4, 0x2A, 0, 7, &XpressNetMasterClass::XNetRxFunc },	//Funktionsbefehl Gruppe7 F37-F44
+	{ 0xE4, 0x2B, 0, 8, &XpressNetMasterClass::XNetRxFunc },	//Funktionsbefehl Gruppe8 F45-F52
+	{ 0xE4, 0x50, 0, 9, &XpressNetMasterClass::XNetRxFunc },	//Funktionsbefehl Gruppe9 F53-F60
+	{ 0xE4, 0x51, 0, 10, &XpressNetMasterClass::XNetRxFunc },	//Funktionsbefehl Gruppe10 F61-F68
+	{ 0xE4, 0xF3, 0, 4, &XpressNetMasterClass::XNetRxFunc },	//undocumented: mulitMAUS is controlling functions F20-F13
+	#endif
+	{ 0xE6, 0x30, 0, 0, &XpressNetMasterClass::XNetRxPOM },	//POM CV write MultiMaus
+	{ 0xE6, XNetAnyCmd, 0, 0, &XpressNetMasterClass::XNetRxNone },
+};
+
+#if defined(XNetSlaveSupport)
+//SLAVE MODE: Central Station broadcast data
+const XNetDispatch XpressNetMasterClass::XNetBroadcastTable[] PROGMEM = {
+	#if defined(XNetFastClock)
+	{ 0x05, 0xF1, 0, 0, &XpressNetMasterClass::XNetRxSlaveClock },	//DCC FAST CLOCK
+	#endif
+	{ 0x42, XNetAnyCmd, 0, 0, &XpressNetMasterClass::XNetRxFeedback },	//Rckmeldung Schaltinformation
+	{ 0x44, XNetAnyCmd, 0, 0, &XpressNetMasterClass::XNetRxFeedback },
+	{ 0x46, XNetAnyCmd, 0, 0, &XpressNetMasterClass::XNetRxFeedback },
+	{ 0x61, 0x00, 0, csTrackVoltageOff, &XpressNetMasterClass::XNetRxPower },	//Track power off
+	{ 0x61, 0x01, 0, csNormal, &XpressNetMasterClass::XNetRxPower },	//Normal Operation Resumed
+	{ 0x61, 0x02, 0, csServiceMode, &XpressNetMasterClass::XNetRxPower },	//Service Mode Entry
+	{ 0x61, 0x08, 0, csShortCircuit, &XpressNetMasterClass::XNetRxPower },	//Track Short
+	{ 0x81, 0x00, 0, csEmergencyStop, &XpressNetMasterClass::XNetRxPower },	//Emergency Stop
+};
+
+//SLAVE MODE: Central Station send data
+const XNetDispatch XpressNetMasterClass::XNetSlaveTable[] PROGMEM = {
+	{ 0x42, XNetAnyCmd, 0, 0, &XpressNetMasterClass::XNetRxSlaveTrnt },	//Antwort Schaltinformation
+	{ 0x62, 0x22, 0, 0, &XpressNetMasterClass::XNetRxSlaveStatus },	//Zustand der Zentrale
+	{ 0x63, 0x21, 0, 0, &XpressNetMasterClass::XNetRxSlaveVersion },	//Version der Zentrale
+	{ 0xE3, 0x52, 0, 0, &XpressNetMasterClass::XNetRxSlaveFkt },	//Antwort abgefrage Funktionen F13-F28
+	{ 0xE4, XNetAnyCmd, 0, 0, &XpressNetMasterClass::XNetRxSlaveLoco },	//Antwort der abgefragen Lok
+};
+#endif
+
 //--------------------------------------------------------------------------------------------
 //Daten Auswerten
 void XpressNetMasterClass::XNetAnalyseReceived(void) {		//work on received data
 
-			#if defined (XNetDEBUG)
-			
-			if (XNetSlaveMode == 0x00) 
-				XNetSerial.print("MRX: 0x1");
-			else XNetSerial.print("SRX: 0x1");
-			XNetSerial.print(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetCallByte], HEX);
-			
-			for (byte i = 1; i < ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetheader] & 0x0F) + 3); i++) {
-				if (XNetRXBuffer.msg[XNetRXBuffer.get].data[i] < 0x10)
-					XNetSerial.print(" 0x0");
-				else XNetSerial.print(" 0x");
-				XNetSerial.print(XNetRXBuffer.msg[XNetRXBuffer.get].data[i], HEX);
-			}
-			XNetSerial.print(" msg:");
-			XNetSerial.println(XNetRXBuffer.get);
-			#endif
-			
-			switch (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetheader]) {	
-			case 0x21:
-				if (XNetSlaveMode == 0x00)	{
-					if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x24 && XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] == 0x05) {		//Command station status indication response
-						/*
-						Bit 0: =1 - Command station is in emergency off (Nothalt)
-						Bit 1: =1 - Command station is in emergency stop (Notaus)
-						Bit 2: Command station-Start mode (0 = manual mode, 1 = automatic mode)
-						Automatic Mode: All locomotives start at their last known speed each
-						time the command station is powered up
-						Manual Mode: All locomotives have a speed of 0 and functions out on
-						command station power up
-						Bit 3: = 1 - The command station is in service mode
-						Bit 4: reserved
-						Bit 5: reserved
-						Bit 6: = 1 - The command station is performing a power up.
-						Bit 7: = 1 - There was a RAM check error in the command station
-						*/
-						byte status = 0x01;	//csTrackVoltageOff = B1;
-						switch (Railpower) {
-							case csNormal:			status = 0; break;
-							case csEmergencyStop:	status = 0x01; break;
-							case csServiceMode:		status = 0x08; break;
-							case csShortCircuit:	status = 0x02; break;
-						}
-						uint8_t sendStatus[] = { DirectedOps, 0x62, 0x22, status, 0x00 };
-						getXOR(sendStatus, 5);
-						XNetsend(sendStatus, 5);
-
-					}
-					if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x21 && XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] == 0x00) {		//Command station softwareversion response
-						uint8_t sendVersion[] = { DirectedOps, 0x63, 0x21, XNetVersion, XNetID, 0x00 }; //63-21 36 0 74
-						getXOR(sendVersion, 6);
-						XNetsend(sendVersion, 6);
-					}
-					if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x80 && XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] == 0xA1) {		//Alles Aus (Notaus)
-						// Track power off
-						Railpower = csTrackVoltageOff;
-						if (notifyXNetPower)
-							notifyXNetPower(Railpower);
-					}
-					if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x81 && XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] == 0xA0) {		//Alles An
-						// Normal Operation Resumed
-						Railpower = csNormal;
-						if (notifyXNetPower)
-							notifyXNetPower(Railpower);
-					}
-					if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x10 && XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] == 0x31) {	//Request for Service Mode results 
-						if (XNetCVAdr != 0) {
-							uint8_t sendStatus[] = { DirectedOps, 0x63, 0x14, lowByte(XNetCVAdr), XNetCVvalue, 0x00};	//Service Mode response for Direct CV mode   
-							getXOR(sendStatus, 6);
-							XNetsend(sendStatus, 6);
-							XNetCVAdr = 0;	//reset CV read Adr
-							XNetCVvalue = 0;//reset CV value
-						}
-						else {
-							// Programming info. "Command station busy" 
-							uint8_t sendStatus[] = { DirectedOps, 0x61, 0x1F, 0x00 };
-							if (XNetCVvalue == 0xFF) { //"no ACK"
-								sendStatus[2] = 0x13; //Programming info. "Data byte not found"
-								XNetCVvalue = 0; //reset error!
-							}
-							// Programming info. "Command station ready " 
-							//uint8_t sendStatus[] = { DirectedOps, 0x61, 0x11, 0x00 };
-							getXOR(sendStatus, 4);
-							XNetsend(sendStatus, 4);	
-						}
-					}
-					if (SlotLokUse[DirectedOps & 0x1F] == 0xFFFF)
-						SlotLokUse[DirectedOps & 0x1F] = 0;	//mark Slot as activ
-					//XNetclear();	//alte Nachricht lschen
-				}
-				break;
-			case 0x22: //Start Programming
-				if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x11) {	//Register Mode read request (Register Mode) 
-				}
-				if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x14) {	//Paged Mode read request (Paged Mode) 
-				}
-				if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x15) {	//Direct Mode CV read request (CV mode)
-					XNetCVAdr = 0;	//no CV read
-					XNetCVvalue = 0;	//no CV value	
-					if (notifyXNetDirectReadCV)
-						notifyXNetDirectReadCV(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2]-1);	//try to read the CV 1..255
-					break;
-				}
-				unknown(); //unbekannte Anfrage
-				//XNetclear();	//alte Nachricht lschen	
-				break;
-			case 0x23:
-				if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x12) { //Register Mode write request (Register Mode) 
-				}
-				if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x16) { //Direct Mode CV write request (CV mode) 
-					XNetCVAdr = 0;	//no CV read
-					XNetCVvalue = 0;	//no CV value
-					if (notifyXNetDirectCV)
-						notifyXNetDirectCV(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2]-1, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]);
-					break;
-				}
-				if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x17) { //0x23 0x17 CV DAT[XOR] - Paged Mode write request(Paged mode)
-					
-				}
-				unknown(); //unbekannte Anfrage
-				//XNetclear();
-				break;
-			case 0xE6: {	//POM CV write MultiMaus
-				if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x30) { 
-					uint16_t Adr = ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F) << 8) + XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3];
-					uint16_t CVAdr = ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4] & B11) << 8) + XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata5];
-					if ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4] & 0xFC) == 0xEC) { //set byte
-						if (notifyXNetPOMwriteByte)
-							notifyXNetPOMwriteByte (Adr, CVAdr, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata6]);
-					}
-					if ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4] & 0xFC) == 0xE8) { //set bit
-						if (notifyXNetPOMwriteBit)
-							notifyXNetPOMwriteBit (Adr, CVAdr, (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata6] & 0x0F));
-					}
-				}
-				break; }
-			case 0x80:
-				if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x80) {		//EmStop
-					//Emergency Stop
-					Railpower = csEmergencyStop;
-					if (notifyXNetPower)
-						notifyXNetPower(Railpower);
-					break;
-				}
-				unknown(); //unbekannte Anfrage
-				//XNetclear();	//alte Nachricht lschen
-				break;
-			case 0xE3: {			
-				if (XNetSlaveMode == 0x00)	{
-					switch (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1]) {
-						case 0x00: //Lokdaten anfordern & F0 bis F12 anfordern
-									if (notifyXNetgiveLocoInfo)
-										notifyXNetgiveLocoInfo(DirectedOps, word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]));
-									break;
-						case 0x07: { //Funktionsstatus F0 bis F12 anfordern (Funktion ist tastend oder nicht tastend)
-									//0x07, sonst ist LokMaus2 langsam!
-									uint8_t LocoFkt[] = { DirectedOps, 0xE3, 0x50, 0x00, 0x00, 0x00 };
-									getXOR(LocoFkt, 6);
-									XNetsend(LocoFkt, 6);	
-									break;
-									}
-						case 0x08: { //Funktionsstatus F13 bis F28 anfordern (Funktion ist tastend oder nicht tastend)
-									uint8_t LocoFkt[] = { DirectedOps, 0xE3, 0x51, 0x00, 0x00, 0x00 };
-									getXOR(LocoFkt, 6);
-									XNetsend(LocoFkt, 6);
-									break;
-									}
-						case 0x09: //Funktionszustand F13 bis F28 anfordern
-									if (notifyXNetgiveLocoFunc)
-										notifyXNetgiveLocoFunc(DirectedOps, word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]));
-									break;
-						case 0xF0: //Lok und Funktionszustand MultiMaus anfordern
-									if (notifyXNetgiveLocoMM)
-										notifyXNetgiveLocoMM(DirectedOps, word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]));
-									break;
-						default: unknown(); //unbekannte Anfrage
-					}
-				}
-				//XNetclear();	//alte Nachricht lschen
-				break;
-				}
-			case 0xE4: {	//Fahrbefehle
-				AddBusySlot(DirectedOps, word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]));	//set Busy
-				if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x10) {	//14 Fahrstufen
-					if (notifyXNetLocoDrive14)
-						notifyXNetLocoDrive14(word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]), XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4]);
-				}
-				else if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x11) {	//27 Fahrstufen
-					if (notifyXNetLocoDrive27)
-						notifyXNetLocoDrive27(word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]), XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4]);
-				}
-				else if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x12) {	//28 Fahrstufen
-					if (notifyXNetLocoDrive28)
-						notifyXNetLocoDrive28(word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]), XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4]);
-				}
-				else if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x13) {	//128 Fahrstufen
-					if (notifyXNetLocoDrive128)
-						notifyXNetLocoDrive128(word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]), XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4]);
-				}
-				else if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x20) {	//Funktionsbefehl Gruppe1 0 0 0 F0 F4 F3 F2 F1
-					if (notifyXNetLocoFunc1)
-						notifyXNetLocoFunc1(word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]), XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4]);
-				}
-				else if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x21) {	//Funktionsbefehl Gruppe2 0000 F8 F7 F6 F5
-					if (notifyXNetLocoFunc2)
-						notifyXNetLocoFunc2(word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]), XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4]);
-				}
-				else if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x22) {	//Funktionsbefehl Gruppe3 0000 F12 F11 F10 F9
-					if (notifyXNetLocoFunc3)
-						notifyXNetLocoFunc3(word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]), XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4]);
-				}
-				else if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x23 || XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0xF3) {	//Funktionsbefehl Gruppe4 F20-F13
-					//0xF3 = undocumented command is used when a mulitMAUS is controlling functions f20..f13. 
-					if (notifyXNetLocoFuncX)
-						notifyXNetLocoFuncX(word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]), 0x04, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4]);
-				}
-				else if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x28) {	//Funktionsbefehl Gruppe5 F28-F21
-					if (notifyXNetLocoFuncX)
-						notifyXNetLocoFuncX(word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]), 0x05, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4]);
-				}
-				else if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x29) {	//Funktionsbefehl Gruppe6 F36-F29
-					if (notifyXNetLocoFuncX)
-						notifyXNetLocoFuncX(word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]), 0x06, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4]);
-				}
-				else if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x2A) {	//Funktionsbefehl Gruppe7 F37-F44
-					if (notifyXNetLocoFuncX)
-						notifyXNetLocoFuncX(word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]), 0x07, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4]);
-				}
-				else if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x2B) {	//Funktionsbefehl Gruppe8 F45-F52
-					if (notifyXNetLocoFuncX)
-						notifyXNetLocoFuncX(word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]), 0x08, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4]);
-				}
-				else if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x50) {	//Funktionsbefehl Gruppe9 F53-F60
-					if (notifyXNetLocoFuncX)
-						notifyXNetLocoFuncX(word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]), 0x09, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4]);
-				}
-				else if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x51) {	//Funktionsbefehl Gruppe10 F61-F68
-					if (notifyXNetLocoFuncX)
-						notifyXNetLocoFuncX(word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]), 0x0A, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4]);
-				}
-				else unknown(); //unbekannte Anfrage
-				/*
-				if (XNetSlaveMode == 0x00)	{	//we are the MASTER
-					//fr MultiMaus als Rckmeldung:
-					if (notifyXNetgiveLocoMM) 
-						notifyXNetgiveLocoMM(DirectedOps, word(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & 0x3F, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]));
-				}
-				*/
-				break;
-				}
-			case 0x42:	//Accessory Decoder information request
-				if (notifyXNetTrntInfo && XNetSlaveMode == 0x00)
-					notifyXNetTrntInfo(DirectedOps, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1], XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2]);
-				//XNetclear();	//alte Nachricht lschen
-				break;
-			case 0x43:	//Accessory Decoder >1024 information request
-				if (notifyXNetTrntInfo && XNetSlaveMode == 0x00)
-					notifyXNetTrntInfo(DirectedOps, (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] << 8) | XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2], XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]);
-				break;
-			case 0x52:	//Accessory Decoder operation request
-				if (notifyXNetTrnt)
-					notifyXNetTrnt((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] << 2) | ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & B110) >> 1), XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2]);
-					//XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] = 0000 ABBP
-					//A = Weichenausgang(Spulenspannung EIN/AUS)
-					//BB = Adresse des Dekoderport 1..4
-					//P = Ausgang (Gerade = 0 / Abzweigen = 1)
-				//XNetclear();	//alte Nachricht lschen
-				break;
-			case 0x53:	//Accessory Decoder >1024 operation request ab Version 3.8
-				if (notifyXNetTrnt)
-					notifyXNetTrnt(( ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] << 8) | XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2]) << 2) | ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3] & B110) >> 1), XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]);	
-				break;
-			default:  //Befehl in Zentrale nicht vorhanden
-				unknown(); //unbekannte Anfrage
-			}
+	//decode the paket only once:
+	XNetRX.data = XNetRXBuffer.msg[XNetRXBuffer.get].data;
+	XNetRX.header = XNetRX.data[XNetheader];
+	XNetRX.cmd = XNetRX.data[XNetdata1];
+	XNetRX.adr = word(XNetRX.data[XNetdata2] & 0x3F, XNetRX.data[XNetdata3]);
+
+	#if defined (XNetDEBUG)
+	if (XNetSlaveMode == 0x00) 
+		XNetSerial.print("MRX: 0x1");
+	else XNetSerial.print("SRX: 0x1");
+	XNetSerial.print(XNetRX.data[XNetCallByte], HEX);
+	
+	for (byte i = 1; i < ((XNetRX.header & 0x0F) + 3); i++) {
+		if (XNetRX.data[i] < 0x10)
+			XNetSerial.print(" 0x0");
+		else XNetSerial.print(" 0x");
+		XNetSerial.print(XNetRX.data[i], HEX);
+	}
+	XNetSerial.print(" msg:");
+	XNetSerial.println(XNetRXBuffer.get);
+	#endif
+	
+	if (!XNetDispatchTable(XNetMasterTable, sizeof(XNetMasterTable) / sizeof(XNetDispatch)))
+		unknown();	//Befehl in Zentrale nicht vorhanden
 	
+	#if defined(XNetSlaveSupport)
 	if (XNetSlaveMode != 0x00) {		//SLAVE-MODE
-		if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetCallByte] == GENERAL_BROADCAST) {		//Central Station broadcast data
-			if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetheader] == 0x61) {
-			  if ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x01) && (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] == 0x60)) {
-				// Normal Operation Resumed
-				Railpower = csNormal;
-				if (notifyXNetPower)
-					notifyXNetPower(Railpower);
-			  } 
-			  else if ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x00) && (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] == 0x61)) {
-				// Track power off
-				Railpower = csTrackVoltageOff;
-				if (notifyXNetPower)
-					notifyXNetPower(Railpower);
-			  }
-			  else if ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x08)) {
-				  // Track Short
-				  Railpower = csShortCircuit;
-				  if (notifyXNetPower)
-					notifyXNetPower(Railpower);
-			  }
-			  else if ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x02) && (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] == 0x63)) {
-				// Service Mode Entry
-				Railpower = csServiceMode;
-				if (notifyXNetPower)
-					notifyXNetPower(Railpower);
-			  }
-			} 
-			else if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetheader] == 0x81) {
-				if ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x00) && (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] == 0x81)) {
-					//Emergency Stop
-					Railpower = csEmergencyStop;
-					if (notifyXNetPower)
-						notifyXNetPower(Railpower);
-				}
-			}
-			else if ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetheader] & 0xF0) == 0x40) {
-				//Rckmeldung Schaltinformation
-				byte len = (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetheader] & 0x0F) / 2;	//each Adr and Data
-				if(notifyXNetFeedback) {
-					for (byte i = 1; i <= len; i++) {
-						notifyXNetFeedback((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetheader+(i*2)-1] << 2) | ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetheader+(i*2)] & B110) >> 1), XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetheader+(i*2)]);
-					//XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] = 0000 ABBP
-					//A = Weichenausgang(Spulenspannung EIN/AUS)
-					//BB = Adresse des Dekoderport 1..4
-					//P = Ausgang (Gerade = 0 / Abzweigen = 1)
-					}
-				}
-			}
-			else if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetheader] == 0x05 && XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0xF1) {
-			  //DCC FAST CLOCK set request
-			  /* 0x05 0xF1 TCODE1 TCODE2 TCODE3 TCODE4 [XOR]
-				00mmmmmm	TCODE1, mmmmmm = denotes minutes, range 0...59.
-				100HHHHH	TCODE2, HHHHH = denotes hours, range 0...23.
-				01000www	TCODE3, www = denotes day of week, 0=monday, 1=tuesday, a.s.o.
-				110fffff	TCODE4, fffff = denotes speed ratio, range 0..31. (0=stopped)
-				*/
-			}
-		}	//Broadcast END
-		else if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetCallByte] == ACK_REQ) {	 	//Central Station ask client for ACK?
-			uint8_t AckSeq[] = {0x00, 0x20, 0x20};
-			XNetsend (AckSeq, 3);
+		if (XNetRX.data[XNetCallByte] == GENERAL_BROADCAST) 	//Central Station broadcast data
+			XNetDispatchTable(XNetBroadcastTable, sizeof(XNetBroadcastTable) / sizeof(XNetDispatch));
+		else if (XNetSlaveOwn(XNetRX.data[XNetCallByte], 0x00)) {	 	//Central Station ask client for ACK?
+			XNetsendCached(0x00, XNetFrameAck);
 		}	//ACK END
-		else {	//Central Station send data ...
-			switch (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetheader]) {	
-				case 0x52:	// Some other device asked for an accessory change
-						break;
-				case 0x61:  //Zustand
-						break;
-				case 0x62:	//Version
-						if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x22) {
-							switch (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2]) {
-								case 0x00:	//csNormal
-											Railpower = csNormal;
-											if (notifyXNetPower)
-												notifyXNetPower(Railpower);
-											break;
-								case 0x02:	//csTrackVoltageOff
-											Railpower = csTrackVoltageOff;
-											if (notifyXNetPower)
-												notifyXNetPower(Railpower);
-											break;
-								case 0x01:	//csEmergencyStop
-											Railpower = csEmergencyStop;
-											if (notifyXNetPower)
-												notifyXNetPower(Railpower);
-											break;
-								case 0x08:	//csServiceMode
-											Railpower = csServiceMode;
-											if (notifyXNetPower)
-												notifyXNetPower(Railpower);
-											break;
-							}
-							if (XNetSlaveInit == 2) {
-								XNetSlaveInit = 0xFF;	//init Fertig!
-							}
-						}
-						break;
-				case 0x63:
-						if (XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x21) {
-							//x1FF 0x63 0x21 0x36 0x13 0x67		Version der Zentrale
-							if (XNetSlaveInit == 1) {
-								XNetSlaveInit = 2;	//init Fertig!
-								//starte 2. Stufe
-								//Slave Init Softwareversion anfragen:
-								getStatus();		//0x21, 0x24, 0x05
-							}
-						}
-						break;
-				case 0xE3:	//Antwort abgefrage Funktionen F13-F28
-						if (SlaveRequestLocoFkt != 0 && XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x52) {		//save Loco and KENNUNG
-							if (notifyXNetLocoFuncX) {
-								notifyXNetLocoFuncX(SlaveRequestLocoFkt, 0x04, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2]);
-								notifyXNetLocoFuncX(SlaveRequestLocoFkt, 0x05, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]);
-							}
-							SlaveRequestLocoFkt = 0; 	//reset
-						}
-						break;
-				case 0xE4:	//Antwort der abgefragen Lok
-						if (SlaveRequestLocoInfo != 0) {		//save Loco
-							switch(XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1]) {		//KENNUNG
-								case 0x00: 	if (notifyXNetLocoDrive14)
-												notifyXNetLocoDrive14(SlaveRequestLocoInfo, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2]);
-											break;	//14 steps
-								case 0x01: 	if (notifyXNetLocoDrive27)
-												notifyXNetLocoDrive27(SlaveRequestLocoInfo, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2]);
-											break;	//17 steps			
-								case 0x02:	if (notifyXNetLocoDrive28)
-												notifyXNetLocoDrive28(SlaveRequestLocoInfo, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2]);
-											break;	//28 steps
-								case 0x04:  if (notifyXNetLocoDrive128)
-												notifyXNetLocoDrive128(SlaveRequestLocoInfo, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2]);
-											break;	//128 steps
-							}
-							if (notifyXNetLocoFunc1)
-								notifyXNetLocoFunc1(SlaveRequestLocoInfo, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]);
-							if (notifyXNetLocoFunc2)
-								notifyXNetLocoFunc2(SlaveRequestLocoInfo, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4] & 0x0F);
-							if (notifyXNetLocoFunc3)
-								notifyXNetLocoFunc3(SlaveRequestLocoInfo, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata4] >> 4);
-							SlaveRequestLocoInfo = 0;		//reset
-						}
-						if (SlaveRequestLocoFkt != 0 && XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] == 0x51) {		//LENZ only F13-F28
-							if (notifyXNetLocoFuncX) {
-								notifyXNetLocoFuncX(SlaveRequestLocoFkt, 0x04, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2]);
-								notifyXNetLocoFuncX(SlaveRequestLocoFkt, 0x05, XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata3]);
-							}
-							SlaveRequestLocoFkt = 0; 	//reset
-						}
-						break;
-				case 0x42:	//Antwort Schaltinformation
-						if (notifyXNetTrnt)
-							notifyXNetTrnt((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata1] << 2) | ((XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2] & B110) >> 1), XNetRXBuffer.msg[XNetRXBuffer.get].data[XNetdata2]);
-						break;
-				case 0xE1:  //Err Lok control
-						break;
-			}	//switch HEADER END
-		}	//MY_ADDRESS END
+		else if (XNetRX.data[XNetCallByte] == FB_BROADCAST || XNetSlaveOwn(XNetRX.data[XNetCallByte], 0x60))
+			XNetDispatchTable(XNetSlaveTable, sizeof(XNetSlaveTable) / sizeof(XNetDispatch));	//Central Station send data ...
 	}	//ENDE SLAVE MODE
+	#endif
 }
 
 //--------------------------------------------------------------------------------------------
-//Rckmeldung ber Zustand Master-Mode:
-bool XpressNetMasterClass::getOperationModeMaster(void) 
-{
-	if (XNetSlaveMode == 0x00) {
-		return true;	//Master Mode
+//find the handler for the received paket and call it
+bool XpressNetMasterClass::XNetDispatchTable(const XNetDispatch *table, uint8_t count) {
+	XNetDispatch entry;
+	if (!XNetFindEntry(table, count, XNetRX.cmd, &entry)) {
+		if (!XNetFindEntry(table, count, XNetAnyCmd, &entry))
+			return false;	//unknown paket
 	}
-	return false;	//Slave Mode
+	if ((entry.flags & XNetOnlyMaster) && (XNetSlaveMode != 0x00))
+		return true;	//nothing to do in SLAVE MODE
+	
+	if (!XNetRXBuffer.msg[XNetRXBuffer.get].answered)	//not already answered by the receive interrupt
+		(this->*entry.handler)(entry.param);
+	
+	if ((entry.flags & XNetMarkSlot) && (SlotLokUse[DirectedOps & 0x1F] == 0xFFFF))
+		SlotLokUse[DirectedOps & 0x1F] = 0;	//mark Slot as activ
+	return true;
 }
 
 //--------------------------------------------------------------------------------------------
-//Befehl in Zentrale nicht vorhanden
-void XpressNetMasterClass::unknown(void)		//unbekannte Anfrage
-{
-	if (XNetSlaveMode == 0x00) {		//MASTER MODE
-		uint8_t NotIn[] = {DirectedOps, 0x61, 0x82, 0xE3 };	
-		XNetsend(NotIn, 4);
+//binary search in the sorted dispatch table
+bool XpressNetMasterClass::XNetFindEntry(const XNetDispatch *table, uint8_t count, uint8_t cmd, XNetDispatch *entry) {
+	uint16_t key = word(XNetRX.header, cmd);
+	uint8_t low = 0;
+	uint8_t high = count;
+	while (low < high) {
+		uint8_t mid = (low + high) / 2;
+		memcpy_P(entry, &table[mid], sizeof(XNetDispatch));	//read out of flash
+		uint16_t found = word(entry->header, entry->cmd);
+		if (found == key)
+			return true;
+		if (found < key)
+			low = mid + 1;
+		else high = mid;
 	}
+	return false;
 }
 
 //--------------------------------------------------------------------------------------------
-void XpressNetMasterClass::getNextXNetAdr(void)
-{
-	XNetAdr++;		//nchste Adresse im XNet
-	if (XNetAdr == 0)
-		XNetAdr++;		//nchste Adresse im XNet 1..31 only!
-	uint8_t TempAdr = XNetAdr % 32;
-		
-	if (XNetAdr > 31) {	//wenn letzte erreicht von Beginn!
-		//search for used slots to call them more then unused:
-		while((SlotLokUse[TempAdr % 32] == 0xFFFF) && (TempAdr <= 31)) {	//slot used an loco address?
-			TempAdr++;
-			XNetAdr++;		//nchste Adresse im XNet
-		}
-		if ((TempAdr % 32) == 0)
-			TempAdr = 1;	//start at the beginning
+//Handler for received pakets:
 
-	}
-	
+//nothing to do
+void XpressNetMasterClass::XNetRxNone(uint8_t) {
+}
+
+//--------------------------------------------------------------------------------------------
+void XpressNetMasterClass::XNetRxUnknown(uint8_t) {
+	unknown(); //unbekannte Anfrage
+}
+
+//--------------------------------------------------------------------------------------------
+//Command station status indication response
+void XpressNetMasterClass::XNetRxStatus(uint8_t) {
 	/*
-	AAAAA = XNetAdr % 32 (Slot 1 to 31)
-	Call Byte Definitions: 
-	Call_Response 					P11A AAAA
-	Call_Inquiry					P10A AAAA
-	Call_Request_Ack_From_Device	P00A AAAA
-	Call_Broadcast					P110 0000
-	Call_Transfer_Err				P11A AAAA
+	Bit 0: =1 - Command station is in emergency off (Nothalt)
+	Bit 1: =1 - Command station is in emergency stop (Notaus)
+	Bit 2: Command station-Start mode (0 = manual mode, 1 = automatic mode)
+	Automatic Mode: All locomotives start at their last known speed each
+	time the command station is powered up
+	Manual Mode: All locomotives have a speed of 0 and functions out on
+	command station power up
+	Bit 3: = 1 - The command station is in service mode
+	Bit 4: reserved
+	Bit 5: reserved
+	Bit 6: = 1 - The command station is performing a power up.
+	Bit 7: = 1 - There was a RAM check error in the command station
 	*/
-	//Generate byte for the new window:
-	CallByteInquiry = callByteParity((TempAdr % 32) | 0x40); // | 0x100;	// the address for Call Byte Window
-	RequestAck = callByteParity((TempAdr % 32)| 0x00); // | 0x100;		// the address for a request acknowlegement sent
-	DirectedOps = callByteParity((TempAdr % 32)| 0x60); // | 0x100;		// the address when we are sending ops
-	
-	//Send CallByteInquiry for next Addr:
-	uint8_t NormalInquiry[] = { CallByteInquiry };
-	XNetsend(NormalInquiry, 1);
-	
-	XNetRXBuffer.msg[XNetRXBuffer.put].length = 0;	//clear - only for sync!
-	XNetRXBuffer.msg[XNetRXBuffer.put].data[XNetCallByte] = CallByteInquiry;	//add CallByte to RX because we are Master
+	switch (Railpower) {
+		case csNormal:			XNetsendCached(DirectedOps, XNetFrameStatusNormal); break;
+		case csServiceMode:		XNetsendCached(DirectedOps, XNetFrameStatusService); break;
+		case csShortCircuit:	XNetsendCached(DirectedOps, XNetFrameStatusShort); break;
+		default:				XNetsendCached(DirectedOps, XNetFrameStatusOff);	//csEmergencyStop, csTrackVoltageOff
+	}
 }
 
 //--------------------------------------------------------------------------------------------
-//Zustand der Gleisversorgung setzten
-void XpressNetMasterClass::setPower(byte Power) 
-{	switch (Power) {	
-	  case csNormal: {
-			if (XNetSlaveMode == 0x00) {		//MASTER MODE
-				uint8_t NormalPower[] = { GENERAL_BROADCAST, 0x61, 0x01, 0x60 };
-				XNetsend(NormalPower, 4);
-			}
-			else {
-				uint8_t PowerAn[] = {0x00, 0x21, 0x81, 0xA0 };
-				XNetsend(PowerAn, 4);
-			}
-			break;
-		}
-	  case csEmergencyStop: {
-			if (XNetSlaveMode == 0x00) {		//MASTER MODE
-				uint8_t EStopPower[] = { GENERAL_BROADCAST, 0x81, 0x00, 0x81 };
-				XNetsend(EStopPower, 4);
-			}
-			else {
-				uint8_t EmStop[] = {0x00, 0x80, 0x80 };
-				XNetsend(EmStop, 3);
-			}
-			break;
-		}
-	  case csTrackVoltageOff: {
-			if (XNetSlaveMode == 0x00) {		//MASTER MODE
-				uint8_t OffPower[] = { GENERAL_BROADCAST, 0x61, 0x00, 0x61 };
-				XNetsend(OffPower, 4);
-			}
-			else {
-				uint8_t PowerAus[] = {0x00, 0x21, 0x80, 0xA1 };
-				XNetsend(PowerAus, 4);
-			}
-			break;
+//Command station softwareversion response
+void XpressNetMasterClass::XNetRxVersion(uint8_t) {
+	XNetsendCached(DirectedOps, XNetFrameVersion); //63-21 36 0 74
+}
+
+//--------------------------------------------------------------------------------------------
+//Power State change
+void XpressNetMasterClass::XNetRxPower(uint8_t Power) {
+	Railpower = Power;
+	if (notifyXNetPower)
+		notifyXNetPower(Railpower);
+}
+
+#if defined(XNetServiceMode)
+//--------------------------------------------------------------------------------------------
+//Request for Service Mode results 
+void XpressNetMasterClass::XNetRxCVResult(uint8_t) {
+	XNetCVJob *job = XNetCVFind(DirectedOps, false);
+	if (job == NULL || job->state == XNetCVWait || job->state == XNetCVRun) {
+		// Programming info. "Command station busy" 
+		XNetsendCached(DirectedOps, XNetFrameProgBusy);
+		// Programming info. "Command station ready " = 0x61, 0x11
+		return;
+	}
+	XNetCVDeliver(job);	//result again, maybe the throttle miss it
+	job->state = XNetCVFree;
+}
+
+//--------------------------------------------------------------------------------------------
+//Direct Mode CV read request (CV mode)
+void XpressNetMasterClass::XNetRxCVRead(uint8_t) {
+	XNetCVRequest(false);
+}
+
+//--------------------------------------------------------------------------------------------
+//Direct Mode CV write request (CV mode) 
+void XpressNetMasterClass::XNetRxCVWrite(uint8_t) {
+	XNetCVRequest(true);
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+//POM CV write MultiMaus
+void XpressNetMasterClass::XNetRxPOM(uint8_t) {
+	uint16_t CVAdr = ((XNetRX.data[XNetdata4] & B11) << 8) + XNetRX.data[XNetdata5];
+	if ((XNetRX.data[XNetdata4] & 0xFC) == 0xEC) { //set byte
+		if (notifyXNetPOMwriteByte)
+			notifyXNetPOMwriteByte (XNetRX.adr, CVAdr, XNetRX.data[XNetdata6]);
+	}
+	if ((XNetRX.data[XNetdata4] & 0xFC) == 0xE8) { //set bit
+		if (notifyXNetPOMwriteBit)
+			notifyXNetPOMwriteBit (XNetRX.adr, CVAdr, (XNetRX.data[XNetdata6] & 0x0F));
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//Lokdaten anfordern & F0 bis F12 anfordern
+void XpressNetMasterClass::XNetRxLocoInfo(uint8_t) {
+	#if defined(XNetLocoCache)
+	XNetLocoState *loco = XNetFindLoco(XNetRX.adr, false);
+	if (loco != NULL) {	//answer from the cache
+		uint8_t *LocoInfo = XNetTXReserveFrame(DirectedOps);
+		if (LocoInfo == NULL)
+			return;
+		LocoInfo[XNetheader] = 0xE4;
+		LocoInfo[XNetdata1] = loco->steps;
+		if (SlotLokUse[DirectedOps & 0x1F] == 0x00)	//has Slot a Address? 
+			LocoInfo[XNetdata1] |= 0x08;	//set BUSY
+		LocoInfo[XNetdata2] = loco->speed;
+		LocoInfo[XNetdata3] = loco->func[0];
+		LocoInfo[XNetdata4] = loco->func[1];
+		XNetTXCommit(7);
+		return;
+	}
+	#endif
+	if (notifyXNetgiveLocoInfo)
+		notifyXNetgiveLocoInfo(DirectedOps, XNetRX.adr);
+}
+
+//--------------------------------------------------------------------------------------------
+//Funktionsstatus anfordern (Funktion ist tastend oder nicht tastend)
+void XpressNetMasterClass::XNetRxFktMode(uint8_t Ident) {
+	//0x07, sonst ist LokMaus2 langsam!
+	if (Ident == 0x51)
+		XNetsendCached(DirectedOps, XNetFrameFktStatusHigh);	//F13 bis F28
+	else XNetsendCached(DirectedOps, XNetFrameFktStatus);	//F0 bis F12
+}
+
+#if defined(XNetExtFunctions)
+//--------------------------------------------------------------------------------------------
+//Funktionszustand F13 bis F28 anfordern
+void XpressNetMasterClass::XNetRxLocoFunc(uint8_t) {
+	#if defined(XNetLocoCache)
+	XNetLocoState *loco = XNetFindLoco(XNetRX.adr, false);
+	if (loco != NULL) {	//answer from the cache
+		SetFktStatus(DirectedOps, loco->func[2], loco->func[3]);
+		return;
+	}
+	#endif
+	if (notifyXNetgiveLocoFunc)
+		notifyXNetgiveLocoFunc(DirectedOps, XNetRX.adr);
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+//Lok und Funktionszustand MultiMaus anfordern
+void XpressNetMasterClass::XNetRxLocoMM(uint8_t) {
+	#if defined(XNetLocoCache)
+	XNetLocoState *loco = XNetFindLoco(XNetRX.adr, false);
+	if (loco != NULL) {	//answer from the cache
+		uint8_t *LocoInfo = XNetTXReserveFrame(DirectedOps);
+		if (LocoInfo == NULL)
+			return;
+		LocoInfo[XNetheader] = 0xE7;
+		LocoInfo[XNetdata1] = loco->steps;
+		LocoInfo[XNetdata2] = loco->speed;
+		LocoInfo[XNetdata3] = 0x20 | loco->func[0];
+		LocoInfo[XNetdata4] = loco->func[1];
+		#if defined(XNetExtFunctions)
+		LocoInfo[XNetdata5] = loco->func[2];
+		LocoInfo[XNetdata6] = loco->func[3];
+		#else
+		LocoInfo[XNetdata5] = 0x00;	//F20-F13
+		LocoInfo[XNetdata6] = 0x00;	//F28-F21
+		#endif
+		LocoInfo[XNetdata7] = 0x00;
+		XNetTXCommit(10);
+		return;
+	}
+	#endif
+	if (notifyXNetgiveLocoMM)
+		notifyXNetgiveLocoMM(DirectedOps, XNetRX.adr);
+}
+
+//--------------------------------------------------------------------------------------------
+//Emergency stop a locomotive: 0x92 AddrH AddrL or 0x91 loco_addr (v2)
+void XpressNetMasterClass::XNetRxLocoEmStop(uint8_t Long) {
+	uint16_t Adr = XNetRX.data[XNetdata1];
+	if (Long)
+		Adr = word(XNetRX.data[XNetdata1] & 0x3F, XNetRX.data[XNetdata2]);
+	if (notifyXNetLocoEmStop)
+		notifyXNetLocoEmStop(Adr);	//first, the loco must stop now
+	#if defined(XNetLocoCache)
+	XNetLocoState *loco = XNetFindLoco(Adr, false);
+	if (loco != NULL)
+		loco->speed = (loco->speed & 0x80) | 0x01;	//Nothalt, keep the direction
+	#endif
+	#if defined(XNetBusyTracker)
+	if (XNetSlaveMode != 0x00)
+		return;
+	//MASTER MODE: the driver of the loco get busy before all waiting pakets
+	for (XpressNetMasterClass *bus = XNetFirstBus; bus != NULL; bus = bus->XNetNextBus) {
+		if (bus != this || XNetOwner[XNetOwnerPos(Adr)] != (DirectedOps & 0x1F))
+			bus->XNetLocoTaken(Adr, true);
+	}
+	#endif
+}
+
+//--------------------------------------------------------------------------------------------
+//Fahrbefehle
+void XpressNetMasterClass::XNetRxDrive(uint8_t Steps) {
+	AddBusySlot(DirectedOps, XNetRX.adr);	//set Busy
+	#if defined(XNetLocoCache)
+	XNetCacheDrive(XNetRX.adr, Steps, XNetRX.data[XNetdata4]);
+	#endif
+	switch (Steps) {
+		case Loco14: if (notifyXNetLocoDrive14)
+						notifyXNetLocoDrive14(XNetRX.adr, XNetRX.data[XNetdata4]);
+					break;
+		case Loco27: if (notifyXNetLocoDrive27)
+						notifyXNetLocoDrive27(XNetRX.adr, XNetRX.data[XNetdata4]);
+					break;
+		case Loco28: if (notifyXNetLocoDrive28)
+						notifyXNetLocoDrive28(XNetRX.adr, XNetRX.data[XNetdata4]);
+					break;
+		case Loco128: if (notifyXNetLocoDrive128)
+						notifyXNetLocoDrive128(XNetRX.adr, XNetRX.data[XNetdata4]);
+					break;
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//Funktionsbefehle
+void XpressNetMasterClass::XNetRxFunc(uint8_t Group) {
+	AddBusySlot(DirectedOps, XNetRX.adr);	//set Busy
+	#if defined(XNetLocoCache)
+	XNetCacheFunc(XNetRX.adr, Group, XNetRX.data[XNetdata4]);
+	#endif
+	switch (Group) {
+		case 1: if (notifyXNetLocoFunc1)
+					notifyXNetLocoFunc1(XNetRX.adr, XNetRX.data[XNetdata4]);
+				break;
+		case 2: if (notifyXNetLocoFunc2)
+					notifyXNetLocoFunc2(XNetRX.adr, XNetRX.data[XNetdata4]);
+				break;
+		case 3: if (notifyXNetLocoFunc3)
+					notifyXNetLocoFunc3(XNetRX.adr, XNetRX.data[XNetdata4]);
+				break;
+		default: if (notifyXNetLocoFuncX)	//Gruppe4 F20-F13, Gruppe5 F28-F21, .....
+					notifyXNetLocoFuncX(XNetRX.adr, Group, XNetRX.data[XNetdata4]);
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//Accessory Decoder information request
+void XpressNetMasterClass::XNetRxTrntInfo(uint8_t Over1024) {
+	#if defined(XNetTrntStore)
+	uint16_t Module = Over1024 ? word(XNetRX.data[XNetdata1], XNetRX.data[XNetdata2]) : XNetRX.data[XNetdata1];
+	if (XNetTrntOwn(Module)) {	//turnout decoder, answer out of the store
+		SetTrntStatus(DirectedOps, Module, XNetTrntNibble(Module, XNetRX.data[Over1024 ? XNetdata3 : XNetdata2]));
+		return;
+	}
+	#endif
+	if (notifyXNetTrntInfo) {
+		if (Over1024)
+			notifyXNetTrntInfo(DirectedOps, (XNetRX.data[XNetdata1] << 8) | XNetRX.data[XNetdata2], XNetRX.data[XNetdata3]);
+		else notifyXNetTrntInfo(DirectedOps, XNetRX.data[XNetdata1], XNetRX.data[XNetdata2]);
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//Accessory Decoder operation request
+void XpressNetMasterClass::XNetRxTrnt(uint8_t Over1024) {
+	//Data = 0000 ABBP
+	//A = Weichenausgang(Spulenspannung EIN/AUS)
+	//BB = Adresse des Dekoderport 1..4
+	//P = Ausgang (Gerade = 0 / Abzweigen = 1)
+	if (notifyXNetTrnt) {
+		if (Over1024)	//ab Version 3.8
+			notifyXNetTrnt(( ((XNetRX.data[XNetdata1] << 8) | XNetRX.data[XNetdata2]) << 2) | ((XNetRX.data[XNetdata3] & B110) >> 1), XNetRX.data[XNetdata3]);	
+		else notifyXNetTrnt((XNetRX.data[XNetdata1] << 2) | ((XNetRX.data[XNetdata2] & B110) >> 1), XNetRX.data[XNetdata2]);
+	}
+	#if defined(XNetTrntStore)
+	if (Over1024)
+		XNetTrntSet((word(XNetRX.data[XNetdata1], XNetRX.data[XNetdata2]) << 2) | ((XNetRX.data[XNetdata3] & B110) >> 1), XNetRX.data[XNetdata3]);
+	else XNetTrntSet((XNetRX.data[XNetdata1] << 2) | ((XNetRX.data[XNetdata2] & B110) >> 1), XNetRX.data[XNetdata2]);
+	#endif
+}
+
+#if defined(XNetSlaveSupport)
+//--------------------------------------------------------------------------------------------
+//SLAVE MODE: Rckmeldung Schaltinformation
+void XpressNetMasterClass::XNetRxFeedback(uint8_t) {
+	byte len = (XNetRX.header & 0x0F) / 2;	//each Adr and Data
+	if(notifyXNetFeedback) {
+		for (byte i = 1; i <= len; i++) {
+			notifyXNetFeedback((XNetRX.data[XNetheader+(i*2)-1] << 2) | ((XNetRX.data[XNetheader+(i*2)] & B110) >> 1), XNetRX.data[XNetheader+(i*2)]);
+			//Data = 0000 ABBP
+			//A = Weichenausgang(Spulenspannung EIN/AUS)
+			//BB = Adresse des Dekoderport 1..4
+			//P = Ausgang (Gerade = 0 / Abzweigen = 1)
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//SLAVE MODE: Zustand der Zentrale
+void XpressNetMasterClass::XNetRxSlaveStatus(uint8_t) {
+	switch (XNetRX.data[XNetdata2]) {
+		case 0x00:	XNetRxPower(csNormal); break;
+		case 0x02:	XNetRxPower(csTrackVoltageOff); break;
+		case 0x01:	XNetRxPower(csEmergencyStop); break;
+		case 0x08:	XNetRxPower(csServiceMode); break;
+	}
+	if (XNetSlaveInit == 2) {
+		XNetSlaveInit = 0xFF;	//init Fertig!
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//SLAVE MODE: Version der Zentrale
+void XpressNetMasterClass::XNetRxSlaveVersion(uint8_t) {
+	//x1FF 0x63 0x21 0x36 0x13 0x67		Version der Zentrale
+	if (XNetSlaveInit == 1) {
+		XNetSlaveInit = 2;	//init Fertig!
+		//starte 2. Stufe
+		//Slave Init Softwareversion anfragen:
+		getStatus();		//0x21, 0x24, 0x05
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//SLAVE MODE: Antwort abgefrage Funktionen F13-F28
+void XpressNetMasterClass::XNetRxSlaveFkt(uint8_t) {
+	uint16_t Adr = XNetSlaveReqAdr(0x08);
+	if (Adr != 0) {		//save Loco and KENNUNG
+		if (notifyXNetLocoFuncX) {
+			notifyXNetLocoFuncX(Adr, 0x04, XNetRX.data[XNetdata2]);
+			notifyXNetLocoFuncX(Adr, 0x05, XNetRX.data[XNetdata3]);
+		}
+		XNetSlaveReqDone(); 	//reset, send the next request
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//SLAVE MODE: Antwort der abgefragen Lok
+void XpressNetMasterClass::XNetRxSlaveLoco(uint8_t) {
+	uint16_t Adr = XNetSlaveReqAdr(0x00);
+	if (Adr != 0) {		//save Loco
+		switch(XNetRX.cmd) {		//KENNUNG
+			case 0x00: 	if (notifyXNetLocoDrive14)
+							notifyXNetLocoDrive14(Adr, XNetRX.data[XNetdata2]);
+						break;	//14 steps
+			case 0x01: 	if (notifyXNetLocoDrive27)
+							notifyXNetLocoDrive27(Adr, XNetRX.data[XNetdata2]);
+						break;	//17 steps			
+			case 0x02:	if (notifyXNetLocoDrive28)
+							notifyXNetLocoDrive28(Adr, XNetRX.data[XNetdata2]);
+						break;	//28 steps
+			case 0x04:  if (notifyXNetLocoDrive128)
+							notifyXNetLocoDrive128(Adr, XNetRX.data[XNetdata2]);
+						break;	//128 steps
+		}
+		if (notifyXNetLocoFunc1)
+			notifyXNetLocoFunc1(Adr, XNetRX.data[XNetdata3]);
+		if (notifyXNetLocoFunc2)
+			notifyXNetLocoFunc2(Adr, XNetRX.data[XNetdata4] & 0x0F);
+		if (notifyXNetLocoFunc3)
+			notifyXNetLocoFunc3(Adr, XNetRX.data[XNetdata4] >> 4);
+		XNetSlaveReqDone();		//reset, send the next request
+	}
+	else if (XNetRX.cmd == 0x51) {		//LENZ only F13-F28
+		Adr = XNetSlaveReqAdr(0x08);
+		if (Adr != 0) {
+			if (notifyXNetLocoFuncX) {
+				notifyXNetLocoFuncX(Adr, 0x04, XNetRX.data[XNetdata2]);
+				notifyXNetLocoFuncX(Adr, 0x05, XNetRX.data[XNetdata3]);
+			}
+			XNetSlaveReqDone(); 	//reset, send the next request
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//SLAVE MODE: Antwort Schaltinformation
+void XpressNetMasterClass::XNetRxSlaveTrnt(uint8_t) {
+	if (notifyXNetTrnt)
+		notifyXNetTrnt((XNetRX.data[XNetdata1] << 2) | ((XNetRX.data[XNetdata2] & B110) >> 1), XNetRX.data[XNetdata2]);
+}
+#endif
+
+#if defined(XNetFastClock)
+//--------------------------------------------------------------------------------------------
+//DCC FAST CLOCK request of a device
+void XpressNetMasterClass::XNetRxClock(uint8_t) {
+	XNetSendClock(DirectedOps);
+}
+
+#if defined(XNetSlaveSupport)
+//--------------------------------------------------------------------------------------------
+//SLAVE MODE: DCC FAST CLOCK 0x05 0xF1 TCODE0 TCODE1 TCODE2 TCODE3
+void XpressNetMasterClass::XNetRxSlaveClock(uint8_t) {
+	uint8_t Minute = 0, Hour = 0, Day = 0, Factor = 0;
+	for (byte i = XNetdata2; i <= XNetdata5; i++) {
+		uint8_t t = XNetRX.data[i];
+		if ((t & 0xC0) == 0x00)
+			Minute = t & 0x3F;	//00MM MMMM
+		else if ((t & 0xE0) == 0x80)
+			Hour = t & 0x1F;	//100H HHHH
+		else if ((t & 0xF8) == 0x40)
+			Day = t & 0x07;		//0100 0WWW
+		else if ((t & 0xE0) == 0xC0)
+			Factor = t & 0x1F;	//110F FFFF
+	}
+	if (notifyXNetFastClock)
+		notifyXNetFastClock(Day, Hour, Minute, Factor);
+}
+#endif
+#endif
+
+//--------------------------------------------------------------------------------------------
+//Rckmeldung ber Zustand Master-Mode:
+bool XpressNetMasterClass::getOperationModeMaster(void) 
+{
+	if (XNetSlaveMode == 0x00) {
+		return true;	//Master Mode
+	}
+	return false;	//Slave Mode
+}
+
+//--------------------------------------------------------------------------------------------
+//Befehl in Zentrale nicht vorhanden
+void XpressNetMasterClass::unknown(void)		//unbekannte Anfrage
+{
+	if (XNetSlaveMode == 0x00) {		//MASTER MODE
+		XNetsendCached(DirectedOps, XNetFrameUnknown);
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+void XpressNetMasterClass::getNextXNetAdr(void)
+{
+	uint8_t TempAdr = 0;
+	
+	//give the active slots extra windows between the normal slots:
+	if (XNetActiveTurn < XNetActiveWeight) {
+		for (byte s = 0; s < 31; s++) {
+			XNetActiveAdr = (XNetActiveAdr % 31) + 1;	//next slot 1..31
+			if (SlotActivity[XNetActiveAdr] > 0) {
+				TempAdr = XNetActiveAdr;
+				XNetActiveTurn++;
+				break;
+			}
+		}
+	}
+	
+	if (TempAdr == 0) {
+		XNetActiveTurn = 0;
+		//normal slot, unused slots are only called in the discovery round:
+		do {
+			XNetAdr++;		//nchste Adresse im XNet
+			if (XNetAdr > 31) {	//wenn letzte erreicht von Beginn!
+				XNetAdr = 1;	//1..31 only!
+				XNetStartRound();	//no slot used = discovery round, so we stop on slot 1
+			}
+		} while ((XNetRound != 0) && !XNetSlotUsed(XNetAdr));	//slot used or discovery
+		TempAdr = XNetAdr;
+	}
+	
+	/*
+	AAAAA = XNetAdr % 32 (Slot 1 to 31)
+	Call Byte Definitions: 
+	Call_Response 					P11A AAAA
+	Call_Inquiry					P10A AAAA
+	Call_Request_Ack_From_Device	P00A AAAA
+	Call_Broadcast					P110 0000
+	Call_Transfer_Err				P11A AAAA
+	*/
+	//Generate byte for the new window:
+	CallByteInquiry = callByteParity((TempAdr % 32) | 0x40); // | 0x100;	// the address for Call Byte Window
+	RequestAck = callByteParity((TempAdr % 32)| 0x00); // | 0x100;		// the address for a request acknowlegement sent
+	DirectedOps = callByteParity((TempAdr % 32)| 0x60); // | 0x100;		// the address when we are sending ops
+	
+	#if defined(XNetStatistics)
+	XNetStat.slot[TempAdr % 32].calls++;
+	#endif
+	
+	//Send CallByteInquiry for next Addr:
+	uint8_t NormalInquiry[] = { CallByteInquiry };
+	XNetCallWait = true;
+	XNetsend(NormalInquiry, 1);
+	
+	XNetRXSync = CallByteInquiry;	//add CallByte to the next RX message because we are Master
+}
+
+//--------------------------------------------------------------------------------------------
+//begin a new round over all slots
+void XpressNetMasterClass::XNetStartRound(void)
+{
+	#if defined(XNetStatistics)
+	XNetStat.roundTime = micros() - XNetRoundTime;
+	XNetRoundTime = micros();
+	if (XNetStat.roundTime > XNetStat.roundTimeMax)
+		XNetStat.roundTimeMax = XNetStat.roundTime;
+	#endif
+	
+	if (millis() - XNetActiveTick >= 100) {	//decrease activity each 100ms
+		XNetActiveTick = millis();
+		for (byte s = 1; s < 32; s++) {
+			if (SlotActivity[s] > 0)
+				SlotActivity[s]--;
+		}
+	}
+	
+	XNetRound++;
+	bool used = false;
+	for (byte s = 1; s < 32 && !used; s++)
+		used = XNetSlotUsed(s);
+	#if defined(XNetPowerSave)
+	if (XNetPowerSaveOn)
+		used = false;	//slow polling: each round is a discovery round, so each slot is called in 31 polls
+	#endif
+	if (!used || (XNetRound >= XNetDiscoveryRounds))
+		XNetRound = 0;	//discovery round, call all slots; also when no slot is used
+}
+
+//--------------------------------------------------------------------------------------------
+//Zustand der Gleisversorgung setzten
+void XpressNetMasterClass::setPower(byte Power) 
+{	switch (Power) {	
+	  case csNormal: {
+			if (XNetSlaveMode == 0x00) {		//MASTER MODE
+				XNetsendCachedPrio(GENERAL_BROADCAST, XNetFramePowerOn);
+			}
+			else {
+				XNetsendCachedPrio(0x00, XNetFrameReqPowerOn);
+			}
+			break;
+		}
+	  case csEmergencyStop: {
+			if (XNetSlaveMode == 0x00) {		//MASTER MODE
+				XNetsendCachedPrio(GENERAL_BROADCAST, XNetFramePowerEStop);
+			}
+			else {
+				XNetsendCachedPrio(0x00, XNetFrameReqEStop);
+			}
+			break;
+		}
+	  case csTrackVoltageOff: {
+			if (XNetSlaveMode == 0x00) {		//MASTER MODE
+				XNetsendCachedPrio(GENERAL_BROADCAST, XNetFramePowerOff);
+			}
+			else {
+				XNetsendCachedPrio(0x00, XNetFrameReqPowerOff);
+			}
+			break;
 		}
 	  case csShortCircuit: {
 			if (XNetSlaveMode == 0x00) {		//MASTER MODE
-				uint8_t ShortPower[] = { GENERAL_BROADCAST, 0x61, 0x08, 0x69 };
-				XNetsend(ShortPower, 4);
+				XNetsendCachedPrio(GENERAL_BROADCAST, XNetFramePowerShort);
 			}
 			break;
 		}
 	  case csServiceMode: {
 			if (XNetSlaveMode == 0x00) {		//MASTER MODE
-				uint8_t ServicePower[] = { GENERAL_BROADCAST, 0x61, 0x02, 0x63 };
-				XNetsend(ServicePower, 4);
+				XNetsendCachedPrio(GENERAL_BROADCAST, XNetFramePowerService);
 			}
 			break;
 		}
@@ -830,10 +1369,63 @@ void XpressNetMasterClass::setPower(byte Power)
 //Rckmeldung verteilen
 void XpressNetMasterClass::setBCFeedback(byte data1, byte data2) 
 {
-	uint8_t Feedback[] = { GENERAL_BROADCAST, 0x42, data1, data2, 0x00};
-	XNetsend(Feedback, 5);
+	#if (XNetFeedbackBuffer > 0)
+	//data2 = ITTN ZZZZ, one pair for each Adr and nibble (N):
+	for (byte i = 0; i < XNetFBCount; i++) {
+		if ((XNetFBData[i][0] == data1) && ((XNetFBData[i][1] & 0x10) == (data2 & 0x10))) {
+			XNetFBData[i][1] = data2;	//merge, only the last state is send
+			return;
+		}
+	}
+	if (XNetFBCount >= XNetFeedbackBuffer)
+		XNetFeedbackFlush();	//no space left, send the waiting pairs now
+	if (XNetFBCount >= XNetFeedbackBuffer) {
+		XNetTXOverrun++;	//Send Buffer is also full, the new pair is lost
+		return;
+	}
+	XNetFBData[XNetFBCount][0] = data1;
+	XNetFBData[XNetFBCount][1] = data2;
+	XNetFBCount++;
+	#else
+	uint8_t *Feedback = XNetTXReserveFrame(GENERAL_BROADCAST);
+	if (Feedback == NULL)
+		return;
+	Feedback[XNetheader] = 0x42;
+	Feedback[XNetdata1] = data1;
+	Feedback[XNetdata2] = data2;
+	XNetTXCommit(5);
+	#endif
 }
 
+#if (XNetFeedbackBuffer > 0)
+//--------------------------------------------------------------------------------------------
+//collected Rckmeldung verteilen, pack up to XNetFeedbackPairs in one paket
+void XpressNetMasterClass::XNetFeedbackFlush(void) 
+{
+	byte send = 0;
+	while (send < XNetFBCount) {
+		byte pairs = XNetFBCount - send;
+		if (pairs > XNetFeedbackPairs)
+			pairs = XNetFeedbackPairs;
+		if (!XNetFBRoom() || XNetReplay)
+			break;	//try again in the next update()
+		uint8_t *Feedback = XNetTXReserveFrame(GENERAL_BROADCAST);
+		Feedback[XNetheader] = 0x40 | (pairs * 2);
+		for (byte i = 0; i < pairs; i++) {
+			Feedback[XNetdata1 + (i * 2)] = XNetFBData[send][0];
+			Feedback[XNetdata2 + (i * 2)] = XNetFBData[send][1];
+			send++;
+		}
+		XNetTXCommit(3 + (pairs * 2));
+	}
+	XNetFBCount -= send;	//keep the pairs that are not send in order
+	for (byte i = 0; i < XNetFBCount; i++) {
+		XNetFBData[i][0] = XNetFBData[send + i][0];
+		XNetFBData[i][1] = XNetFBData[send + i][1];
+	}
+}
+#endif
+
 //--------------------------------------------------------------------------------------------
 //Lok in use (Request/Vormerken)
 void XpressNetMasterClass::ReqLocoBusy(uint16_t Adr) {
@@ -841,60 +1433,178 @@ void XpressNetMasterClass::ReqLocoBusy(uint16_t Adr) {
 	//BusyAdrCount = 0;
 	//AddBusySlot(0, Adr);
 	
-	for (byte s = 1; s < 32; s++) {
-		if (SlotLokUse[s] == Adr) {	//if in use from X-Net device -> set busy
-			SetLocoBusy(callByteParity(s | 0x60), SlotLokUse[s]);
-			SlotLokUse[s] = 0;	//clean slot
-		}
-	}
+	for (XpressNetMasterClass *bus = XNetFirstBus; bus != NULL; bus = bus->XNetNextBus)
+		bus->XNetLocoTaken(Adr);	//busy on all bus
 	SlotLokUse[0] = Adr;
 }
 
+//--------------------------------------------------------------------------------------------
+//the loco is now used on another bus or by the sketch
+void XpressNetMasterClass::XNetLocoTaken(uint16_t Adr, bool prio) {
+	#if defined(XNetBusyTracker)
+	uint8_t pos = XNetOwnerPos(Adr);
+	uint8_t owner = XNetOwner[pos];
+	if (owner != 0) {	//if in use from X-Net device -> set busy
+		XNetSendBusy(callByteParity(owner | 0x60), Adr, prio);
+		XNetOwnerRemove(pos);
+		SlotLokUse[owner] = 0;	//clean slot
+	}
+	#else
+	(void)prio;	//only for the busy message
+	#endif
+	if (SlotLokUse[0] == Adr)
+		SlotLokUse[0] = 0xFFFF;	//no longer used by the sketch of this bus
+}
+
 //--------------------------------------------------------------------------------------------
 //Lok in use (Busy)
 void XpressNetMasterClass::SetLocoBusy(uint8_t UserOps, uint16_t Adr) {
-	uint8_t LocoInfo[] = { UserOps, 0xE3, 0x40, 0x00, 0x00, 0x00 };
-	if (Adr > 99) //Xpressnet long addresses (100 to 9999: AH/AL = 0xC064 to 0xE707)
-		LocoInfo[3] = (Adr >> 8) | 0xC0;
-	else LocoInfo[3] = Adr >> 8;   //short addresses (0 to 99: AH = 0x0000 and AL = 0x0000 to 0x0063)
-	LocoInfo[4] = Adr & 0xFF;
-	getXOR(LocoInfo, 6);
-	XNetsend(LocoInfo, 6);
+	XNetSendBusy(UserOps, Adr, false);
 }
 
+//--------------------------------------------------------------------------------------------
+//Lok in use (Busy), prio = send it before the waiting pakets
+void XpressNetMasterClass::XNetSendBusy(uint8_t UserOps, uint16_t Adr, bool prio) {
+	uint8_t *LocoInfo = prio ? XNetTXReservePrio(UserOps) : XNetTXReserveFrame(UserOps);
+	if (LocoInfo == NULL)
+		return;
+	LocoInfo[XNetheader] = 0xE3;
+	LocoInfo[XNetdata1] = 0x40;
+	XNetSetLocoAdr(&LocoInfo[XNetdata2], Adr);
+	if (prio)
+		XNetTXCommitPrio(6);
+	else XNetTXCommit(6);
+}
+
+#if defined(XNetSlaveSupport)
 //--------------------------------------------------------------------------------------------
 //Zentralen Status an XNet abfragen
 void XpressNetMasterClass::getStatus() {
-	uint8_t commandVersionSequence[] = { 0x00, 0x21, 0x24, 0x05};
-	XNetsend (commandVersionSequence, 4);
+	XNetsendCached(0x00, XNetFrameReqStatus);
 }
 
 //--------------------------------------------------------------------------------------------
 //Lokinfo an XNet abfragen
 void XpressNetMasterClass::getLocoInfo(uint16_t Adr) {
-	uint8_t LocoInfo[] = { 0x00, 0xE3, 0x00, 0x00, 0x00, 0x00 };
-	if (Adr > 99) //Xpressnet long addresses (100 to 9999: AH/AL = 0xC064 to 0xE707)
-		LocoInfo[3] = (Adr >> 8) | 0xC0;
-	else LocoInfo[3] = Adr >> 8;   //short addresses (0 to 99: AH = 0x0000 and AL = 0x0000 to 0x0063)
-	LocoInfo[4] = Adr & 0xFF;
-	getXOR(LocoInfo, 6);
-	XNetsend(LocoInfo, 6);
-	SlaveRequestLocoInfo = Adr;		//save Loco
+	XNetSlaveReqAdd(Adr, 0x00);	//save Loco
 }
 
 //--------------------------------------------------------------------------------------------
 //Lokfkt an XNet abfragen
 void XpressNetMasterClass::getLocoFkt(uint16_t Adr) {
-	uint8_t LocoInfo[] = { 0x00, 0xE3, 0x08, 0x00, 0x00, 0x00 };
-	if (Adr > 99) //Xpressnet long addresses (100 to 9999: AH/AL = 0xC064 to 0xE707)
-		LocoInfo[3] = (Adr >> 8) | 0xC0;
-	else LocoInfo[3] = Adr >> 8;   //short addresses (0 to 99: AH = 0x0000 and AL = 0x0000 to 0x0063)
-	LocoInfo[4] = Adr & 0xFF;
-	getXOR(LocoInfo, 6);
-	XNetsend(LocoInfo, 6);
-	SlaveRequestLocoFkt = Adr;		//save Loco
+	XNetSlaveReqAdd(Adr, 0x08);	//save Loco
 }
 
+//--------------------------------------------------------------------------------------------
+//SLAVE MODE: our device address 1..31 (Call Byte 0x40 | Adr), only this one
+void XpressNetMasterClass::setSlaveAddress(uint8_t Adr) {
+	Adr &= 0x1F;
+	if (Adr == 0)
+		return;
+	#if defined(__AVR__)
+	uint8_t sreg = SREG;
+	cli();	//read by the receive interrupt
+	#endif
+	XNetSlaveMask = 1UL << Adr;
+	XNetSlaveCall = Adr;
+	#if defined(__AVR__)
+	SREG = sreg;
+	#endif
+}
+
+//--------------------------------------------------------------------------------------------
+//SLAVE MODE: one more device in this instance, each device has its own window
+void XpressNetMasterClass::addSlaveAddress(uint8_t Adr) {
+	Adr &= 0x1F;
+	if (Adr == 0)
+		return;
+	#if defined(__AVR__)
+	uint8_t sreg = SREG;
+	cli();	//read by the receive interrupt
+	#endif
+	XNetSlaveMask |= 1UL << Adr;
+	#if defined(__AVR__)
+	SREG = sreg;
+	#endif
+}
+
+//--------------------------------------------------------------------------------------------
+//SLAVE MODE: the next pakets are only send in the window of this device, 0 = any of our windows
+void XpressNetMasterClass::setSlaveDevice(uint8_t Adr) {
+	Adr &= 0x1F;
+	XNetSlaveTag = (Adr == 0) ? 0x00 : (0x40 | Adr);
+}
+
+//--------------------------------------------------------------------------------------------
+//SLAVE MODE: device address of the received paket
+uint8_t XpressNetMasterClass::getSlaveDevice(void) {
+	return XNetRX.data[XNetCallByte] & 0x1F;
+}
+
+//--------------------------------------------------------------------------------------------
+//SLAVE MODE: add the loco request to the queue, the answer has no address
+//so only the first request is on the bus until the answer or the timeout
+void XpressNetMasterClass::XNetSlaveReqAdd(uint16_t Adr, uint8_t type) {
+	for (uint8_t i = 0; i < XNetSlaveReqCount; i++) {
+		if (XNetSlaveReqList[i].adr == Adr && XNetSlaveReqList[i].type == type)
+			return;	//already waiting
+	}
+	if (XNetSlaveReqCount >= XNetSlaveRequests)
+		return;	//queue is full
+	XNetSlaveReqList[XNetSlaveReqCount].adr = Adr;
+	XNetSlaveReqList[XNetSlaveReqCount].type = type;
+	XNetSlaveReqList[XNetSlaveReqCount].retry = 0;
+	XNetSlaveReqCount++;
+	XNetSlaveReqUpdate();	//send it, when nothing else is waiting
+}
+
+//--------------------------------------------------------------------------------------------
+//SLAVE MODE: send the first request, repeat it after the timeout
+void XpressNetMasterClass::XNetSlaveReqUpdate(void) {
+	if (XNetSlaveReqCount == 0)
+		return;
+	if (XNetSlaveReqSent) {
+		if ((millis() - XNetSlaveReqTime) < XNetSlaveReqTimeout)
+			return;	//wait for the answer
+		XNetSlaveReqSent = false;
+		XNetSlaveReqList[0].retry++;
+		if (XNetSlaveReqList[0].retry > XNetSlaveReqRetry) {
+			XNetSlaveReqDone();	//no answer, drop it
+			return;
+		}
+	}
+	uint8_t *LocoInfo = XNetTXReserveFrame(0x00);
+	if (LocoInfo == NULL)
+		return;	//try again with the next update()
+	LocoInfo[XNetheader] = 0xE3;
+	LocoInfo[XNetdata1] = XNetSlaveReqList[0].type;
+	XNetSetLocoAdr(&LocoInfo[XNetdata2], XNetSlaveReqList[0].adr);
+	XNetTXCommit(6);
+	XNetSlaveReqSent = true;
+	XNetSlaveReqTime = millis();
+}
+
+//--------------------------------------------------------------------------------------------
+//SLAVE MODE: loco of the received answer
+uint16_t XpressNetMasterClass::XNetSlaveReqAdr(uint8_t type) {
+	if (!XNetSlaveReqSent || XNetSlaveReqList[0].type != type)
+		return 0;	//we don't wait for this answer
+	return XNetSlaveReqList[0].adr;
+}
+
+//--------------------------------------------------------------------------------------------
+//SLAVE MODE: remove the first request and send the next one
+void XpressNetMasterClass::XNetSlaveReqDone(void) {
+	if (XNetSlaveReqCount == 0)
+		return;
+	XNetSlaveReqCount--;
+	for (uint8_t i = 0; i < XNetSlaveReqCount; i++)
+		XNetSlaveReqList[i] = XNetSlaveReqList[i + 1];
+	XNetSlaveReqSent = false;
+	XNetSlaveReqUpdate();
+}
+#endif
+
 //--------------------------------------------------------------------------------------------
 //Lokinfo an XNet Melden
 void XpressNetMasterClass::SetLocoInfo(uint8_t UserOps, uint8_t Speed, uint8_t F0, uint8_t F1) {
@@ -912,11 +1622,17 @@ void XpressNetMasterClass::SetLocoInfo(uint8_t UserOps, uint8_t Steps, uint8_t S
 		v |= (Speed >> 4) & 0x01;	//Addition Speed Bit
 		v |= 0x80 & Speed;		//Dir
 	}
-	uint8_t LocoInfo[] = {UserOps, 0xE4, Steps, v, F0, F1, 0x00 };	
+	uint8_t *LocoInfo = XNetTXReserveFrame(UserOps);
+	if (LocoInfo == NULL)
+		return;
+	LocoInfo[XNetheader] = 0xE4;
+	LocoInfo[XNetdata1] = Steps;
+	LocoInfo[XNetdata2] = v;
+	LocoInfo[XNetdata3] = F0;
+	LocoInfo[XNetdata4] = F1;
 	if (SlotLokUse[UserOps & 0x1F] == 0x00)	//has Slot a Address? 
-		LocoInfo[2] |= 0x08;	//set BUSY
-	getXOR(LocoInfo, 7);
-	XNetsend(LocoInfo, 7);
+		LocoInfo[XNetdata1] |= 0x08;	//set BUSY
+	XNetTXCommit(7);
 }
 
 //--------------------------------------------------------------------------------------------
@@ -924,9 +1640,14 @@ void XpressNetMasterClass::SetLocoInfo(uint8_t UserOps, uint8_t Steps, uint8_t S
 void XpressNetMasterClass::SetFktStatus(uint8_t UserOps, uint8_t F4, uint8_t F5) {
 	//F4 = F20-F13
 	//F5 = F28-F21
-	uint8_t LocoFkt[] = {UserOps, 0xE3, 0x52, F4, F5, 0x00 };
-	getXOR(LocoFkt, 6);
-	XNetsend(LocoFkt, 6);
+	uint8_t *LocoFkt = XNetTXReserveFrame(UserOps);
+	if (LocoFkt == NULL)
+		return;
+	LocoFkt[XNetheader] = 0xE3;
+	LocoFkt[XNetdata1] = 0x52;
+	LocoFkt[XNetdata2] = F4;
+	LocoFkt[XNetdata3] = F5;
+	XNetTXCommit(6);
 }
 
 //--------------------------------------------------------------------------------------------
@@ -939,11 +1660,19 @@ void XpressNetMasterClass::SetLocoInfoMM(uint8_t UserOps, uint8_t Steps, uint8_t
 		v |= (Speed >> 4) & 0x01;	//Addition Speed Bit
 		v |= 0x80 & Speed;		//Dir
 	}
-	uint8_t LocoInfo[] = {UserOps,  0xE7, /*0x04*/ Steps, v, 0x20, F1, F2, F3, 0x00, 0x00 };
+	uint8_t *LocoInfo = XNetTXReserveFrame(UserOps);
+	if (LocoInfo == NULL)
+		return;
+	LocoInfo[XNetheader] = 0xE7;
+	LocoInfo[XNetdata1] = Steps;	/*0x04*/
+	LocoInfo[XNetdata2] = v;
 	/*ERROR: Steps change form > 99 to 28steps only!!! why?? (This info comes from DCC:"notifyLokAll(..)"*/
-	LocoInfo[4] |= F0;
-	getXOR(LocoInfo, 10);
-	XNetsend(LocoInfo, 10);
+	LocoInfo[XNetdata3] = 0x20 | F0;
+	LocoInfo[XNetdata4] = F1;
+	LocoInfo[XNetdata5] = F2;
+	LocoInfo[XNetdata6] = F3;
+	LocoInfo[XNetdata7] = 0x00;
+	XNetTXCommit(10);
 }
 
 //--------------------------------------------------------------------------------------------
@@ -958,183 +1687,744 @@ void XpressNetMasterClass::setSpeed(uint16_t Adr, uint8_t Steps, uint8_t Speed)
 		v |= (Speed >> 4) & 0x01;	//Addition Speed Bit
 		v |= 0x80 & Speed;		//Dir
 	}
-	uint8_t LocoInfo[] = {0x00, 0xE4, 0x13, 0x00, 0x00, v, 0x00 }; //default to 128 Steps!
+	uint8_t *LocoInfo = XNetTXReserveFrame(0x00);
+	if (LocoInfo == NULL)
+		return;
+	LocoInfo[XNetheader] = 0xE4;
+	LocoInfo[XNetdata1] = 0x13;	//default to 128 Steps!
 	switch (Steps) {
-		case 14: LocoInfo[2] = 0x10; break;
-		case 27: LocoInfo[2] = 0x11; break;
-		case 28: LocoInfo[2] = 0x12; break;
+		case 14: LocoInfo[XNetdata1] = 0x10; break;
+		case 27: LocoInfo[XNetdata1] = 0x11; break;
+		case 28: LocoInfo[XNetdata1] = 0x12; break;
 	}
-	if (Adr > 99) //Xpressnet long addresses (100 to 9999: AH/AL = 0xC064 to 0xE707)
-		LocoInfo[3] = (Adr >> 8) | 0xC0;
-	else LocoInfo[3] = Adr >> 8;   //short addresses (0 to 99: AH = 0x0000 and AL = 0x0000 to 0x0063)
-	LocoInfo[4] = Adr & 0xFF;
-	getXOR(LocoInfo, 7);
-	XNetsend(LocoInfo, 7);
+	#if defined(XNetLocoCache)
+	XNetCacheDrive(Adr, LocoInfo[XNetdata1] == 0x13 ? Loco128 : (LocoInfo[XNetdata1] & 0x03), v);
+	#endif
+	XNetSetLocoAdr(&LocoInfo[XNetdata2], Adr);
+	LocoInfo[XNetdata4] = v;
+	XNetTXCommit(7);
 }
 
 //--------------------------------------------------------------------------------------------
 //Gruppe 1: 0 0 0 F0 F4 F3 F2 F1
 void XpressNetMasterClass::setFunc0to4(uint16_t Adr, uint8_t G1) { 
-	uint8_t LocoInfo[] = {0x00, 0xE4, 0x20, 0x00, 0x00, G1 & 0x1F, 0x00 };
-	if (Adr > 99) //Xpressnet long addresses (100 to 9999: AH/AL = 0xC064 to 0xE707)
-		LocoInfo[3] = (Adr >> 8) | 0xC0;
-	else LocoInfo[3] = Adr >> 8;   //short addresses (0 to 99: AH = 0x0000 and AL = 0x0000 to 0x0063)
-	LocoInfo[4] = Adr & 0xFF;
-	getXOR(LocoInfo, 7);
-	XNetsend(LocoInfo, 7);
+	XNetSendFuncGroup(Adr, 1, G1);
 }
 
 //--------------------------------------------------------------------------------------------
 //Gruppe 2: 0 0 0 0 F8 F7 F6 F5 
 void XpressNetMasterClass::setFunc5to8(uint16_t Adr, uint8_t G2) { 
-	uint8_t LocoInfo[] = {0x00, 0xE4, 0x21, 0x00, 0x00, G2 & 0x0F, 0x00 };
-	if (Adr > 99) //Xpressnet long addresses (100 to 9999: AH/AL = 0xC064 to 0xE707)
-		LocoInfo[3] = (Adr >> 8) | 0xC0;
-	else LocoInfo[3] = Adr >> 8;   //short addresses (0 to 99: AH = 0x0000 and AL = 0x0000 to 0x0063)
-	LocoInfo[4] = Adr & 0xFF;
-	getXOR(LocoInfo, 7);
-	XNetsend(LocoInfo, 7);
+	XNetSendFuncGroup(Adr, 2, G2);
 }
 
 //--------------------------------------------------------------------------------------------
 //Gruppe 3: 0 0 0 0 F12 F11 F10 F9 
 void XpressNetMasterClass::setFunc9to12(uint16_t Adr, uint8_t G3) { 
-	uint8_t LocoInfo[] = {0x00, 0xE4, 0x22, 0x00, 0x00, G3, 0x00 };
-	if (Adr > 99) //Xpressnet long addresses (100 to 9999: AH/AL = 0xC064 to 0xE707)
-		LocoInfo[3] = (Adr >> 8) | 0xC0;
-	else LocoInfo[3] = Adr >> 8;   //short addresses (0 to 99: AH = 0x0000 and AL = 0x0000 to 0x0063)
-	LocoInfo[4] = Adr & 0xFF;
-	getXOR(LocoInfo, 7);
-	XNetsend(LocoInfo, 7);
+	XNetSendFuncGroup(Adr, 3, G3);
 }
 
+#if defined(XNetExtFunctions)
 //--------------------------------------------------------------------------------------------
 //Gruppe 4: F20 F19 F18 F17 F16 F15 F14 F13  
 void XpressNetMasterClass::setFunc13to20(uint16_t Adr, uint8_t G4) { 
-	uint8_t LocoInfoMM[] = {0x00, 0xE4, 0xF3, 0x00, 0x00, G4, 0x00 };	//normal: 0x23!
-	if (Adr > 99) //Xpressnet long addresses (100 to 9999: AH/AL = 0xC064 to 0xE707)
-		LocoInfoMM[3] = (Adr >> 8) | 0xC0;
-	else LocoInfoMM[3] = Adr >> 8;   //short addresses (0 to 99: AH = 0x0000 and AL = 0x0000 to 0x0063)
-	LocoInfoMM[4] = Adr & 0xFF;
-	getXOR(LocoInfoMM, 7);
-	XNetsend(LocoInfoMM, 7);
-
-	LocoInfoMM[0] = 0x00;
-	LocoInfoMM[1] = 0xE4;
-	LocoInfoMM[2] = 0x23; 	//MultiMaus only
-	LocoInfoMM[3] = Adr >> 8;
-	LocoInfoMM[4] = Adr & 0xFF;
-	LocoInfoMM[5] = G4;
-	getXOR(LocoInfoMM, 7);
-	XNetsend(LocoInfoMM, 7);
+	XNetSendFuncGroup(Adr, 4, G4);
 }
 
 //--------------------------------------------------------------------------------------------
 //Gruppe 5: F28 F27 F26 F25 F24 F23 F22 F21  
 void XpressNetMasterClass::setFunc21to28(uint16_t Adr, uint8_t G5) { 
-	uint8_t LocoInfo[] = {0x00, 0xE4, 0x28, 0x00, 0x00, G5, 0x00 };
+	XNetSendFuncGroup(Adr, 5, G5);
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+//Gruppe 1..10: F0 to F68, with the loco cache only send when the group change
+void XpressNetMasterClass::setFuncGroup(uint16_t Adr, uint8_t Group, uint8_t Bits) {
+	#if defined(XNetLocoCache)
+	XNetLocoState *loco = XNetFindLoco(Adr, false);
+	if (loco != NULL && XNetCacheGroup(loco, Group) == (Bits & XNetFuncMask(Group)))
+		return;	//nothing new for the devices
+	#endif
+	XNetSendFuncGroup(Adr, Group, Bits);
+}
+
+//--------------------------------------------------------------------------------------------
+//send function group 1..10 and save it in the cache
+void XpressNetMasterClass::XNetSendFuncGroup(uint16_t Adr, uint8_t Group, uint8_t Bits) {
+	if (Group < 1 || Group > XNetFuncGroups)
+		return;
+	Bits &= XNetFuncMask(Group);
+	#if defined(XNetLocoCache)
+	XNetCacheFunc(Adr, Group, Bits);
+	#endif
+	if (Group != 4) {
+		XNetSendLocoFunc(Adr, pgm_read_byte(&XNetFuncCmd[Group - 1]), Bits);
+		return;
+	}
+	#if defined(XNetExtFunctions)
+	XNetSendLocoFunc(Adr, 0xF3, Bits);	//normal: 0x23!
+
+	uint8_t *LocoInfoMM = XNetTXReserveFrame(0x00);
+	if (LocoInfoMM == NULL)
+		return;
+	LocoInfoMM[XNetheader] = 0xE4;
+	LocoInfoMM[XNetdata1] = 0x23; 	//MultiMaus only
+	LocoInfoMM[XNetdata2] = Adr >> 8;
+	LocoInfoMM[XNetdata3] = Adr & 0xFF;
+	LocoInfoMM[XNetdata4] = Bits;
+	XNetTXCommit(7);
+	#endif
+}
+
+#if defined(XNetFastClock)
+//--------------------------------------------------------------------------------------------
+//MASTER MODE: start the fast clock, Factor 0 = the clock stop, max 31
+void XpressNetMasterClass::setFastClock(uint8_t Day, uint8_t Hour, uint8_t Minute, uint8_t Factor) {
+	XNetClock[0] = Minute % 60;
+	XNetClock[1] = Hour % 24;
+	XNetClock[2] = Day % 7;
+	XNetClock[3] = Factor & 0x1F;
+	XNetClockNext = millis();
+	XNetClockRest = 0;
+	XNetClockStep();	//first model minute
+	XNetClockDue = true;	//send the new time
+}
+
+//--------------------------------------------------------------------------------------------
+//time of the next model minute, add from the last one so the ticks don't drift
+void XpressNetMasterClass::XNetClockStep(void) {
+	uint8_t Factor = XNetClock[3];
+	if (Factor == 0)
+		return;	//clock stop
+	XNetClockNext += 60000UL / Factor;
+	XNetClockRest += 60000UL % Factor;
+	if (XNetClockRest >= Factor) {
+		XNetClockRest -= Factor;
+		XNetClockNext++;
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//MASTER MODE: count the model minutes, the frame waits for a free window
+void XpressNetMasterClass::XNetClockUpdate(void) {
+	while (XNetClock[3] != 0 && (long)(millis() - XNetClockNext) >= 0) {	//also catch up when update() was late
+		XNetClockStep();
+		XNetClockDue = true;
+		if (++XNetClock[0] < 60)
+			continue;
+		XNetClock[0] = 0;
+		if (++XNetClock[1] < 24)
+			continue;
+		XNetClock[1] = 0;
+		XNetClock[2] = (XNetClock[2] + 1) % 7;
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//send the fast clock: 0x05 0xF1 TCODE0 TCODE1 TCODE2 TCODE3
+void XpressNetMasterClass::XNetSendClock(uint8_t CallByte) {
+	uint8_t *Clock = XNetTXReserveFrame(CallByte);
+	if (Clock == NULL)
+		return;
+	if (CallByte == GENERAL_BROADCAST)
+		XNetClockDue = false;
+	Clock[XNetheader] = 0x05;
+	Clock[XNetdata1] = 0xF1;
+	Clock[XNetdata2] = XNetClock[0];		//00MM MMMM
+	Clock[XNetdata3] = 0x80 | XNetClock[1];	//100H HHHH
+	Clock[XNetdata4] = 0x40 | XNetClock[2];	//0100 0WWW
+	Clock[XNetdata5] = 0xC0 | XNetClock[3];	//110F FFFF
+	XNetTXCommit(8);
+}
+#endif
+
+#if defined(XNetLocoCache)
+//--------------------------------------------------------------------------------------------
+//remove loco from the cache, 0 = all
+void XpressNetMasterClass::clearLocoCache(uint16_t Adr) {
+	for (byte i = 0; i < XNetLocoCache; i++) {
+		if (Adr == 0 || XNetLocos[i].adr == Adr)
+			XNetLocos[i].adr = 0;	//free
+	}
+	if (Adr == 0)
+		XNetLocoNext = 0;
+}
+
+//--------------------------------------------------------------------------------------------
+//search loco in the cache, add = replace the oldest entry if not found
+XNetLocoState *XpressNetMasterClass::XNetFindLoco(uint16_t Adr, bool add) {
+	if (Adr == 0)
+		return NULL;
+	for (byte i = 0; i < XNetLocoCache; i++) {
+		if (XNetLocos[i].adr == Adr)
+			return &XNetLocos[i];
+	}
+	if (!add)
+		return NULL;	//not in the cache
+	XNetLocoState *loco = &XNetLocos[XNetLocoNext];
+	XNetLocoNext = (XNetLocoNext + 1) % XNetLocoCache;
+	loco->adr = Adr;
+	loco->steps = Fahrstufe;	//default
+	loco->speed = 0x80;	//forward, stop
+	for (byte f = 0; f < sizeof(loco->func); f++)
+		loco->func[f] = 0x00;
+	return loco;
+}
+
+//--------------------------------------------------------------------------------------------
+//save speed and direction, Speed is RVVV VVVV like on the XpressNet
+void XpressNetMasterClass::XNetCacheDrive(uint16_t Adr, uint8_t Steps, uint8_t Speed) {
+	XNetLocoState *loco = XNetFindLoco(Adr, true);
+	if (loco == NULL)
+		return;
+	loco->steps = Steps;
+	loco->speed = Speed;
+}
+
+//--------------------------------------------------------------------------------------------
+//save function group 1..10
+void XpressNetMasterClass::XNetCacheFunc(uint16_t Adr, uint8_t Group, uint8_t Data) {
+	XNetLocoState *loco = XNetFindLoco(Adr, true);
+	if (loco == NULL)
+		return;
+	switch (Group) {
+		case 1: loco->func[0] = Data & 0x1F; break;	//000 F0 F4 F3 F2 F1
+		case 2: loco->func[1] = (loco->func[1] & 0xF0) | (Data & 0x0F); break;	//F8-F5
+		case 3: loco->func[1] = (loco->func[1] & 0x0F) | (Data << 4); break;	//F12-F9
+		default: if (Group <= XNetFuncGroups)
+					loco->func[Group - 2] = Data;	//F20-F13, F28-F21, ... F68-F61
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//read function group 1..10 like on the XpressNet
+uint8_t XpressNetMasterClass::XNetCacheGroup(const XNetLocoState *loco, uint8_t Group) {
+	switch (Group) {
+		case 1: return loco->func[0];
+		case 2: return loco->func[1] & 0x0F;
+		case 3: return loco->func[1] >> 4;
+		default: if (Group <= XNetFuncGroups)
+					return loco->func[Group - 2];
+	}
+	return 0x00;
+}
+
+//--------------------------------------------------------------------------------------------
+//function group 1..10 of the cache, 0 = not in the cache
+uint8_t XpressNetMasterClass::getFuncGroup(uint16_t Adr, uint8_t Group) {
+	XNetLocoState *loco = XNetFindLoco(Adr, false);
+	if (loco == NULL)
+		return 0x00;
+	return XNetCacheGroup(loco, Group);
+}
+
+//--------------------------------------------------------------------------------------------
+//switch one function F0..F68, only its group is send
+//false = loco not in the cache, we don't know the other functions of the group
+bool XpressNetMasterClass::setFunc(uint16_t Adr, uint8_t F, bool on) {
+	uint8_t Group, Bit;
+	if (F == 0) {
+		Group = 1;
+		Bit = 4;	//000 F0 F4 F3 F2 F1
+	}
+	else if (F <= 12) {
+		Group = ((F - 1) / 4) + 1;	//F1-F4, F5-F8, F9-F12
+		Bit = (F - 1) % 4;
+	}
+	else if (F <= 68) {
+		Group = ((F - 13) / 8) + 4;	//F13-F20, F21-F28, ... F61-F68
+		Bit = (F - 13) % 8;
+	}
+	else return false;
+	XNetLocoState *loco = XNetFindLoco(Adr, false);
+	if (loco == NULL || Group > XNetFuncGroups)
+		return false;	//don't send a guessed group, it would switch off the other functions
+	uint8_t Bits = XNetCacheGroup(loco, Group);
+	if (on)
+		Bits |= 1 << Bit;
+	else Bits &= ~(1 << Bit);
+	setFuncGroup(Adr, Group, Bits);
+	return true;
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+//Funktionsbefehl an XNet senden
+void XpressNetMasterClass::XNetSendLocoFunc(uint16_t Adr, uint8_t Group, uint8_t Data) {
+	uint8_t *LocoInfo = XNetTXReserveFrame(0x00);
+	if (LocoInfo == NULL)
+		return;
+	LocoInfo[XNetheader] = 0xE4;
+	LocoInfo[XNetdata1] = Group;
+	XNetSetLocoAdr(&LocoInfo[XNetdata2], Adr);
+	LocoInfo[XNetdata4] = Data;
+	XNetTXCommit(7);
+}
+
+//--------------------------------------------------------------------------------------------
+//write the loco address as AH and AL
+void XpressNetMasterClass::XNetSetLocoAdr(uint8_t *data, uint16_t Adr) {
 	if (Adr > 99) //Xpressnet long addresses (100 to 9999: AH/AL = 0xC064 to 0xE707)
-		LocoInfo[3] = (Adr >> 8) | 0xC0;
-	else LocoInfo[3] = Adr >> 8;   //short addresses (0 to 99: AH = 0x0000 and AL = 0x0000 to 0x0063)
-	LocoInfo[4] = Adr & 0xFF;
-	getXOR(LocoInfo, 7);
-	XNetsend(LocoInfo, 7);
+		data[0] = (Adr >> 8) | 0xC0;
+	else data[0] = Adr >> 8;   //short addresses (0 to 99: AH = 0x0000 and AL = 0x0000 to 0x0063)
+	data[1] = Adr & 0xFF;
+}
+
+//--------------------------------------------------------------------------------------------
+//Add loco to slot. Slot 0 is reserved for non XpressNet Device
+void XpressNetMasterClass::AddBusySlot(uint8_t UserOps, uint16_t Adr) {
+	uint8_t slot = UserOps & 0x1F;
+	if (Adr == 0 || SlotLokUse[slot] == Adr)	//skip if already in store!
+		return;
+	#if defined(XNetBusyTracker)
+	XNetOwnerRelease(slot);	//the old loco of this slot is free
+	for (XpressNetMasterClass *bus = XNetFirstBus; bus != NULL; bus = bus->XNetNextBus) {
+		if (bus != this)
+			bus->XNetLocoTaken(Adr);	//used on this bus now
+	}
+	uint8_t pos = XNetOwnerPos(Adr);
+	uint8_t owner = XNetOwner[pos];
+	if (owner != 0) {	//if in other Slot -> set busy
+		SetLocoBusy(callByteParity(owner | 0x60), Adr);
+		XNetOwnerRemove(pos);
+		SlotLokUse[owner] = 0;	//clean slot that informed as busy & let it activ
+		pos = XNetOwnerPos(Adr);
+	}
+	SlotLokUse[slot] = Adr;	//store loco that is used
+	if (slot != 0)
+		XNetOwner[pos] = slot;
+	#else
+	SlotLokUse[slot] = Adr;	//only for the slot scheduler
+	#endif
+}
+
+#if defined(XNetBusyTracker)
+//--------------------------------------------------------------------------------------------
+//Loco owner hash: open addressing with linear probing, key is SlotLokUse[slot]
+inline uint8_t XpressNetMasterClass::XNetOwnerHash(uint16_t Adr) {
+	return (Adr ^ (Adr >> 6)) & (XNetOwnerSize - 1);
+}
+
+//--------------------------------------------------------------------------------------------
+//position of the loco in the owner hash, or the free position to add it
+uint8_t XpressNetMasterClass::XNetOwnerPos(uint16_t Adr) {
+	uint8_t pos = XNetOwnerHash(Adr);
+	while ((XNetOwner[pos] != 0) && (SlotLokUse[XNetOwner[pos]] != Adr))
+		pos = (pos + 1) & (XNetOwnerSize - 1);	//max 31 entries, there is always a free one
+	return pos;
+}
+
+//--------------------------------------------------------------------------------------------
+//remove the entry and move the following entries back, so the search finds them
+void XpressNetMasterClass::XNetOwnerRemove(uint8_t pos) {
+	uint8_t next = pos;
+	while (true) {
+		next = (next + 1) & (XNetOwnerSize - 1);
+		uint8_t slot = XNetOwner[next];
+		if (slot == 0)
+			break;
+		uint8_t home = XNetOwnerHash(SlotLokUse[slot]);
+		if (((next - home) & (XNetOwnerSize - 1)) >= ((next - pos) & (XNetOwnerSize - 1))) {
+			XNetOwner[pos] = slot;	//move back
+			pos = next;
+		}
+	}
+	XNetOwner[pos] = 0;
+}
+
+//--------------------------------------------------------------------------------------------
+//remove the loco of the slot from the owner hash
+void XpressNetMasterClass::XNetOwnerRelease(uint8_t slot) {
+	if (slot == 0 || SlotLokUse[slot] == 0 || SlotLokUse[slot] == 0xFFFF)
+		return;	//no loco
+	uint8_t pos = XNetOwnerPos(SlotLokUse[slot]);
+	if (XNetOwner[pos] == slot)
+		XNetOwnerRemove(pos);
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+//TrntPos request return
+void XpressNetMasterClass::SetTrntStatus(uint8_t UserOps, uint16_t Address, uint8_t Data) {
+	if (XNetSlaveMode == 0x00) {		//MASTER MODE
+		// data=ITTN ZZZZ	Z=Weichenausgang1+2 (Aktive/Inaktive);
+		//0x42 AAAA AAAA ITTN ZZZZ
+		//I = is 1, the switching command requested has not been completed
+		//TT = turnout group (0-3)
+		//N = N=0 is the lower nibble, N=1 the upper nibble
+		//Z3 Z2 Z1 Z0 = (Z1,Z0|Z3,Z2) 01 "left", 10 "right"
+		#if defined(XNetTrntStore)
+		if (XNetTrntOwn(Address)) {	//the sketch knows it better
+			if (Data & 0x10)
+				XNetTrnt[Address] = (XNetTrnt[Address] & 0x0F) | (Data << 4);
+			else XNetTrnt[Address] = (XNetTrnt[Address] & 0xF0) | (Data & 0x0F);
+		}
+		#endif
+		uint8_t *TrntInfo = XNetTXReserveFrame(UserOps);
+		if (TrntInfo == NULL)
+			return;
+		if ((Address >> 8) > 0) {
+			TrntInfo[XNetheader] = 0x43;
+			TrntInfo[XNetdata1] = Address >> 8;
+			TrntInfo[XNetdata2] = Address & 0xFF;
+			TrntInfo[XNetdata3] = Data;
+			XNetTXCommit(6);
+		}
+		else {
+			TrntInfo[XNetheader] = 0x42;
+			TrntInfo[XNetdata1] = Address;
+			TrntInfo[XNetdata2] = Data;
+			XNetTXCommit(5);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//Trnt Change position
+void XpressNetMasterClass::SetTrntPos(uint16_t Address, uint8_t state, uint8_t active) {
+	//Accessory Decoder operation request (0x52 | AAAA AAAA | 1000 ABBP | XOr)
+	//1. Byte = AAAA AAAA -> (Adresse >> 2) - ohne Stupenauswahl
+	//2. Byte = 1000 ABBP
+	//A = Weichenausgang(Spulenspannung EIN/AUS)
+	//BB = Adresse des Dekoderport 1..4
+	//P = Ausgang (Gerade = 0 / Abzweigen = 1)
+	#if defined(XNetTrntStore)
+	XNetTrntSet(Address, state);
+	#endif
+	uint8_t *TrntInfo = XNetTXReserveFrame(0x00);
+	if (TrntInfo == NULL)
+		return;
+	TrntInfo[XNetheader] = 0x52;
+	TrntInfo[XNetdata1] = Address >> 2;
+	TrntInfo[XNetdata2] = 0x80;
+	TrntInfo[XNetdata2] |= (Address & 0x03) << 1;
+	TrntInfo[XNetdata2] |= (active & 0x01) << 3;
+	TrntInfo[XNetdata2] |= state & 0x01;
+	XNetTXCommit(5);
+}
+
+#if defined(XNetServiceMode)
+//--------------------------------------------------------------------------------------------
+//return a CV data read, also after a CV write
+void XpressNetMasterClass::setCVReadValue(uint8_t cvAdr, uint8_t value) {
+	if (XNetCVActive != NULL && XNetCVActive->cv == cvAdr)	//result of the actual job?
+		XNetCVFinish(XNetCVDone, value);
+}
+
+//--------------------------------------------------------------------------------------------
+//no ACK
+void XpressNetMasterClass::setCVNack(void) {	
+	if (XNetCVActive != NULL)
+		XNetCVFinish(XNetCVNack, 0xFF);	//Programmierinfo Daten nicht gefunden
+}
+
+//--------------------------------------------------------------------------------------------
+//no ACK SC
+void XpressNetMasterClass::setCVNackSC(void) {	
+	if (XNetCVActive != NULL)
+		XNetCVFinish(XNetCVShort, 0xFF);	//Programmierinfo Kurzschluss
+}
+
+//--------------------------------------------------------------------------------------------
+//CV programming job of the throttle, add = take a free job when there is none
+XNetCVJob *XpressNetMasterClass::XNetCVFind(uint8_t slot, bool add) {
+	XNetCVJob *free = NULL;
+	for (uint8_t i = 0; i < XNetCVJobs; i++) {
+		if (XNetCVList[i].state == XNetCVFree) {
+			if (free == NULL)
+				free = &XNetCVList[i];
+		}
+		else if (XNetCVList[i].slot == slot)
+			return &XNetCVList[i];
+	}
+	return add ? free : NULL;
+}
+
+//--------------------------------------------------------------------------------------------
+//Direct Mode CV read or write request of the throttle in DirectedOps
+void XpressNetMasterClass::XNetCVRequest(bool write) {
+	uint8_t cv = XNetRX.data[XNetdata2] - 1;	//CV 1..256
+	if (XNetSlaveMode != 0x00) {	//SLAVE MODE: only report it
+		if (write) {
+			if (notifyXNetDirectCV)
+				notifyXNetDirectCV(cv, XNetRX.data[XNetdata3]);
+		}
+		else if (notifyXNetDirectReadCV)
+			notifyXNetDirectReadCV(cv);
+		return;
+	}
+	XNetCVJob *job = XNetCVFind(DirectedOps, true);
+	if (job == NULL) {	//all jobs are used by other throttles
+		XNetsendCached(DirectedOps, XNetFrameProgBusy);	//the throttle will try again
+		return;
+	}
+	if (job == XNetCVActive)
+		XNetCVActive = NULL;	//the throttle don't wait for the old result
+	job->slot = DirectedOps;
+	job->state = XNetCVWait;
+	job->write = write;
+	job->cv = cv;
+	job->value = XNetRX.data[XNetdata3];
+	job->time = millis();
+	XNetCVUpdate();	//start it direct when the sketch is free
+}
+
+//--------------------------------------------------------------------------------------------
+//timeouts of the CV programming jobs and give the next job to the sketch
+void XpressNetMasterClass::XNetCVUpdate(void) {
+	unsigned long now = millis();
+	XNetCVJob *next = NULL;
+	for (uint8_t i = 0; i < XNetCVJobs; i++) {
+		XNetCVJob *job = &XNetCVList[i];
+		if (job->state == XNetCVWait) {
+			if (next == NULL || (long)(job->time - next->time) < 0)
+				next = job;	//the oldest request first
+		}
+		else if (job->state != XNetCVFree && (now - job->time) > XNetCVTimeout) {
+			if (job == XNetCVActive)	//the sketch don't answer
+				XNetCVFinish(XNetCVNack, 0xFF);
+			else job->state = XNetCVFree;	//the throttle don't ask for the result
+		}
+	}
+	if (XNetCVActive != NULL || next == NULL)
+		return;
+	XNetCVActive = next;
+	next->state = XNetCVRun;
+	next->time = now;
+	if (next->write) {
+		if (notifyXNetDirectCV)
+			notifyXNetDirectCV(next->cv, next->value);
+	}
+	else if (notifyXNetDirectReadCV)
+		notifyXNetDirectReadCV(next->cv);	//try to read the CV 1..256
+}
+
+//--------------------------------------------------------------------------------------------
+//the sketch is ready with the actual job
+void XpressNetMasterClass::XNetCVFinish(uint8_t state, uint8_t value) {
+	XNetCVJob *job = XNetCVActive;
+	XNetCVActive = NULL;	//next job in update()
+	job->state = state;
+	job->value = value;
+	XNetCVDeliver(job);	//direct, the throttle don't need to ask for it
+}
+
+//--------------------------------------------------------------------------------------------
+//send the result of the CV programming job to the throttle
+void XpressNetMasterClass::XNetCVDeliver(XNetCVJob *job) {
+	job->time = millis();	//keep the result until the throttle ask for it
+	if (job->state == XNetCVNack)
+		XNetsendCached(job->slot, XNetFrameProgNack); //Programming info. "Data byte not found"
+	else if (job->state == XNetCVShort)
+		XNetsendCached(job->slot, XNetFrameProgShort);
+	else {
+		uint8_t *sendStatus = XNetTXReserveFrame(job->slot);
+		if (sendStatus != NULL) {	//Service Mode response for Direct CV mode   
+			sendStatus[XNetheader] = 0x63;
+			sendStatus[XNetdata1] = 0x14;
+			sendStatus[XNetdata2] = job->cv + 1;
+			sendStatus[XNetdata3] = job->value;
+			XNetTXCommit(6);
+		}
+	}
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+//pakets lost because the Read Buffer was full
+uint16_t XpressNetMasterClass::getRXOverrun(void) {
+	return XNetRXOverrun;
+}
+
+#if defined(XNetHardwareUART)
+//--------------------------------------------------------------------------------------------
+//pakets lost because more than one byte was waiting with a parity error (ESP32)
+uint16_t XpressNetMasterClass::getRXResync(void) {
+	return XNetRXResyncs;
+}
+
+//--------------------------------------------------------------------------------------------
+//the 9th bit of the waiting bytes is not known, drop the running paket until the next CallByte
+void XpressNetMasterClass::XNetRXResync(void) {
+	XNetRXclear(XNetRXBuffer.put);
+	XNetRXSync = 0x00;	//MASTER MODE: the answer in this window is lost
+	XNetRXDrop = true;
+	XNetRXResyncs++;
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+//max time in microseconds from setPower() until the paket starts on the bus
+unsigned long XpressNetMasterClass::getPrioLatency(void) {
+	#if defined(__AVR__)
+	uint8_t sreg = SREG;
+	cli();	//written by the TX interrupt
+	unsigned long latency = XNetPrioLatency;
+	SREG = sreg;
+	return latency;
+	#else
+	return XNetPrioLatency;
+	#endif
+}
+
+#if defined(XNetTrace)
+#if defined(XNetHardwareUART)
+static portMUX_TYPE XNetTraceMux = portMUX_INITIALIZER_UNLOCKED;	//send from task and interrupt
+#endif
+
+//--------------------------------------------------------------------------------------------
+//add data to the trace, called from the receive and the send
+void XpressNetMasterClass::XNetTraceAdd(uint16_t data) {
+	#if defined(__AVR__)
+	uint8_t sreg = SREG;
+	cli();	//the first byte is send out of the main loop
+	#elif defined(XNetHardwareUART)
+	portENTER_CRITICAL_SAFE(&XNetTraceMux);
+	#endif
+	uint8_t next = (XNetTracePut + 1) & (XNetTrace - 1);
+	if (next == XNetTraceGet)
+		XNetTraceLost++;	//trace is full, discard
+	else {
+		unsigned long time = micros();
+		unsigned long delta = time - XNetTraceTime;
+		XNetTraceTime = time;
+		XNetTraceBuf[XNetTracePut].delta = (delta > 0xFFFF) ? 0xFFFF : delta;
+		XNetTraceBuf[XNetTracePut].data = data;
+		XNetBarrier();	//all data is written,
+		XNetTracePut = next;	//now publish the entry
+	}
+	#if defined(__AVR__)
+	SREG = sreg;
+	#elif defined(XNetHardwareUART)
+	portEXIT_CRITICAL_SAFE(&XNetTraceMux);
+	#endif
 }
 
 //--------------------------------------------------------------------------------------------
-//check if there are slots with the same loco, set them to busy
-void XpressNetMasterClass::SetBusy(uint8_t slot) {
-	for (byte s = 1; s < 32; s++) {
-		if ((s != slot) && (SlotLokUse[s] == SlotLokUse[slot])) {	//if in other Slot -> set busy
-			SetLocoBusy(callByteParity(s | 0x60), SlotLokUse[s]);
-			SlotLokUse[s] = 0;	//clean slot that informed as busy & let it activ
-		}
+//read out the trace, return number of entries
+uint8_t XpressNetMasterClass::readTrace(XNetTraceEntry *entries, uint8_t max) {
+	uint8_t count = 0;
+	while ((count < max) && (XNetTraceGet != XNetTracePut)) {
+		XNetBarrier();	//read the entry after it was published
+		entries[count] = XNetTraceBuf[XNetTraceGet];
+		count++;
+		XNetBarrier();
+		XNetTraceGet = (XNetTraceGet + 1) & (XNetTrace - 1);	//free the entry
 	}
+	return count;
 }
 
 //--------------------------------------------------------------------------------------------
-//Add loco to slot. Slot 0 is reserved for non XpressNet Device
-void XpressNetMasterClass::AddBusySlot(uint8_t UserOps, uint16_t Adr) {
-	if (Adr == 0 || SlotLokUse[UserOps & 0x1F] == Adr)	//skip if already in store!
-		return;
-	SlotLokUse[UserOps & 0x1F] = Adr;	//store loco that is used
-	SetBusy(UserOps & 0x1F);	//make other busy
+//entries lost because the trace was full
+uint16_t XpressNetMasterClass::getTraceLost(void) {
+	return XNetTraceLost;
 }
-
+#endif
 
 //--------------------------------------------------------------------------------------------
-//TrntPos request return
-void XpressNetMasterClass::SetTrntStatus(uint8_t UserOps, uint16_t Address, uint8_t Data) {
-	if (XNetSlaveMode == 0x00) {		//MASTER MODE
-		// data=ITTN ZZZZ	Z=Weichenausgang1+2 (Aktive/Inaktive);
-		//0x42 AAAA AAAA ITTN ZZZZ
-		//I = is 1, the switching command requested has not been completed
-		//TT = turnout group (0-3)
-		//N = N=0 is the lower nibble, N=1 the upper nibble
-		//Z3 Z2 Z1 Z0 = (Z1,Z0|Z3,Z2) 01 "left", 10 "right"
-		if ((Address >> 8) > 0) {
-			uint8_t TrntInfo[] = {UserOps, 0x43, 0x00, 0x00, 0x00, 0x00 };
-			TrntInfo[2] = Address >> 8;
-			TrntInfo[3] = Address & 0xFF;
-			TrntInfo[4] = Data;
-			getXOR(TrntInfo, 6);
-			XNetsend(TrntInfo, 6);
-		}
-		else {
-			uint8_t TrntInfo[] = {UserOps, 0x42, 0x00, 0x00, 0x00 };
-			TrntInfo[2] = Address;
-			TrntInfo[3] = Data;
-			getXOR(TrntInfo, 5);
-			XNetsend(TrntInfo, 5);
+//put the received data of a trace into the decoder, with the time of the trace
+//there is no polling and no paket goes out, MASTER MODE: the slot comes from the recorded CallByte
+void XpressNetMasterClass::replayTrace(const XNetTraceEntry *entries, uint8_t count) {
+	XNetReplay = true;
+	for (uint8_t i = 0; i < count; i++) {
+		while (XNetRXDecode()) {}	//work on the pakets before, still with their slot
+		#if defined(XNetHost)
+		XNetHostMicros += entries[i].delta;	//virtual time
+		#else
+		unsigned long wait = micros();
+		while ((micros() - wait) < entries[i].delta) {}	//timeouts run like on the bus
+		#endif
+		uint16_t data9 = entries[i].data & 0x1FF;
+		if (entries[i].data & XNetTraceTX) {	//send by the master
+			if ((XNetSlaveMode == 0x00) && ((data9 & 0x160) == 0x140)) {	//CallByte Inquiry P10A AAAA
+				uint8_t slot = data9 & 0x1F;
+				CallByteInquiry = data9 & 0xFF;
+				RequestAck = callByteParity(slot | 0x00);
+				DirectedOps = callByteParity(slot | 0x60);
+				XNetRXSync = CallByteInquiry;	//CallByte for the next received paket
+			}
 		}
+		else XNetRXWord(data9);
 	}
+	while (XNetRXDecode()) {}
+	XNetReplay = false;
 }
 
+#if defined(XNetStatistics)
 //--------------------------------------------------------------------------------------------
-//Trnt Change position
-void XpressNetMasterClass::SetTrntPos(uint16_t Address, uint8_t state, uint8_t active) {
-	//Accessory Decoder operation request (0x52 | AAAA AAAA | 1000 ABBP | XOr)
-	//1. Byte = AAAA AAAA -> (Adresse >> 2) - ohne Stupenauswahl
-	//2. Byte = 1000 ABBP
-	//A = Weichenausgang(Spulenspannung EIN/AUS)
-	//BB = Adresse des Dekoderport 1..4
-	//P = Ausgang (Gerade = 0 / Abzweigen = 1)
-	uint8_t TrntInfo[] = {0x00, 0x52, 0x00, 0x00, 0x00 };
-	TrntInfo[2] = Address >> 2;
-	TrntInfo[3] = 0x80;
-	TrntInfo[3] |= (Address & 0x03) << 1;
-	TrntInfo[3] |= (active & 0x01) << 3;
-	TrntInfo[3] |= state & 0x01;
-	getXOR(TrntInfo, 5);
-	XNetsend(TrntInfo, 5);
+//copy the statistics and start a new bus load measure
+void XpressNetMasterClass::getStats(XNetStats *stats) {
+	#if defined(__AVR__)
+	uint8_t sreg = SREG;
+	cli();	//latency and bytes are written by the interrupt
+	#endif
+	unsigned long bytes = XNetStatBytes;
+	XNetStatBytes = 0;
+	*stats = XNetStat;
+	#if defined(__AVR__)
+	SREG = sreg;
+	#endif
+	stats->rxOverrun = XNetRXOverrun;
+	stats->txOverrun = XNetTXOverrun;
+	unsigned long time = micros() - XNetStatTime;
+	XNetStatTime = micros();
+	if (time > 0) {
+		unsigned long load = (bytes * XNetByteTime) / (time / 100 + 1);	//percent
+		stats->busLoad = (load > 100) ? 100 : load;
+	}
+	else stats->busLoad = 0;
 }
 
 //--------------------------------------------------------------------------------------------
-//return a CV data read
-void XpressNetMasterClass::setCVReadValue(uint8_t cvAdr, uint8_t value) {
-	//Save?:
-	if (cvAdr != 0xFF) {
-		XNetCVAdr = cvAdr+1;
-		XNetCVvalue = value;
+//reset all statistics
+void XpressNetMasterClass::clearStats(void) {
+	for (byte s = 0; s < 32; s++) {
+		XNetStat.slot[s].calls = 0;
+		XNetStat.slot[s].answers = 0;
+		XNetStat.slot[s].xorFails = 0;
+		XNetStat.slot[s].timeouts = 0;
+		XNetStat.slot[s].latencyMin = 0xFFFF;	//no value
+		XNetStat.slot[s].latencyAvg = 0;
+		XNetStat.slot[s].latencyMax = 0;
 	}
+	XNetStat.rxOverrun = 0;
+	XNetStat.txOverrun = 0;
+	XNetStat.busLoad = 0;
+	XNetStat.roundTime = 0;
+	XNetStat.roundTimeMax = 0;
+	XNetStatBytes = 0;
+	XNetStatTime = micros();
+	XNetRoundTime = micros();
 }
+#endif
 
 //--------------------------------------------------------------------------------------------
-//no ACK
-void XpressNetMasterClass::setCVNack(void) {	
-	XNetCVAdr = 0;
-	XNetCVvalue = 0xFF;
-	uint8_t sendStatus[] = { DirectedOps, 0x61, 0x13, 0x72 };	//Programmierinfo Daten nicht gefunden
-	XNetsend(sendStatus, 4);
+//pakets lost because the Send Buffer was full
+uint16_t XpressNetMasterClass::getTXOverrun(void) {
+	return XNetTXOverrun;
 }
 
 //--------------------------------------------------------------------------------------------
-//no ACK SC
-void XpressNetMasterClass::setCVNackSC(void) {	
-	XNetCVAdr = 0;
-	XNetCVvalue = 0xFF;
-	uint8_t sendStatus[] = { DirectedOps, 0x61, 0x12, 0x73 };	//Programmierinfo Kurzschluss
-	XNetsend(sendStatus, 4);
+// is the Send Buffer full? Without counting an overrun
+bool XpressNetMasterClass::XNetTXFull(bool CallByte) {
+	//MASTER MODE: the last free message is only for the CallByte, the devices must get their window
+	uint8_t last = (XNetTXBuffer.put + ((CallByte || XNetSlaveMode != 0x00) ? 0 : 1)) & XNetTXBuffer.mask;
+	return XNetTXBuffer.msg[last].length != 0x00;
+}
+
+//--------------------------------------------------------------------------------------------
+// check for a free message in the Send Buffer
+bool XpressNetMasterClass::XNetTXReserve(bool CallByte) {
+	if (XNetReplay)
+		return false;	//replayTrace(): no answer on the bus
+	if (XNetTXFull(CallByte)) {	//Buffer is full?
+		XNetTXOverrun++;	//discard the new paket
+		#if defined (XNetDEBUG)
+		XNetSerial.println(" TX Overrun!");
+		#endif
+		return false;
+	}
+	return true;
 }
 
 //--------------------------------------------------------------------------------------------
@@ -1147,7 +2437,8 @@ void XpressNetMasterClass::XNetsend(byte *dataString, byte byteCount) {
 		}
 		#endif
 		
-		XNetTXBuffer.msg[XNetTXBuffer.put].length = byteCount;
+		if (!XNetTXReserve(true))
+			return;
 		
 		for (byte i = 0; i < byteCount; i++) {
 			XNetTXBuffer.msg[XNetTXBuffer.put].data[i] = *dataString;	//add data to Buffer
@@ -1164,10 +2455,8 @@ void XpressNetMasterClass::XNetsend(byte *dataString, byte byteCount) {
 			}
 			#endif
 		}
-		
-		XNetTXBuffer.put++;	//go to the next position
-		if (XNetTXBuffer.put >= XNetBufferSize)
-			XNetTXBuffer.put = 0;
+		XNetTXBuffer.msg[XNetTXBuffer.put].frame = NULL;	//send the data
+		XNetTXPublish(byteCount);
 			
 		#if defined (XNetDEBUG)
 		if (byteCount > 1)
@@ -1176,6 +2465,243 @@ void XpressNetMasterClass::XNetsend(byte *dataString, byte byteCount) {
 		
 }
 
+//--------------------------------------------------------------------------------------------
+// get the free message in the Send Buffer to write the paket direct into it
+uint8_t *XpressNetMasterClass::XNetTXReserveFrame(uint8_t CallByte) {
+	if (!XNetTXReserve())
+		return NULL;	//Buffer is full
+	#if defined(XNetSlaveSupport)
+	if (CallByte == 0x00 && XNetSlaveMode != 0x00)
+		CallByte = XNetSlaveTag;	//SLAVE MODE: device of the paket
+	#endif
+	XNetTXBuffer.msg[XNetTXBuffer.put].data[XNetCallByte] = CallByte;
+	XNetTXBuffer.msg[XNetTXBuffer.put].frame = NULL;	//send the data
+	return XNetTXBuffer.msg[XNetTXBuffer.put].data;
+}
+
+//--------------------------------------------------------------------------------------------
+// add the XOR to the reserved message and send it out
+void XpressNetMasterClass::XNetTXCommit(byte byteCount) {
+	getXOR(XNetTXBuffer.msg[XNetTXBuffer.put].data, byteCount);
+	
+	#if defined (XNetDEBUG)
+	XNetSerial.print("XTX: ");
+	for (byte i = 0; i < byteCount; i++) {
+		if (XNetTXBuffer.msg[XNetTXBuffer.put].data[i] < 0x10)
+			XNetSerial.print(" 0x0");
+		else XNetSerial.print(" 0x");
+		if (i == 0 && XNetSlaveMode == 0x00)  //MASTER-MODE
+			XNetSerial.print("1");
+		XNetSerial.print(XNetTXBuffer.msg[XNetTXBuffer.put].data[i], HEX);
+	}
+	XNetSerial.println();
+	#endif
+	
+	XNetTXPublish(byteCount);
+}
+
+//--------------------------------------------------------------------------------------------
+// publish the message at put to the running transmission
+void XpressNetMasterClass::XNetTXPublish(byte byteCount) {
+	XNetBarrier();	//all data is written,
+	XNetTXBuffer.msg[XNetTXBuffer.put].length = byteCount;	//now publish the message
+	XNetTXBuffer.put = (XNetTXBuffer.put + 1) & XNetTXBuffer.mask;	//go to the next position
+}
+
+//--------------------------------------------------------------------------------------------
+// send a cached frame out of PROGMEM, only the CallByte is copied
+void XpressNetMasterClass::XNetsendFrame(uint8_t CallByte, const uint8_t *frame, byte byteCount) {
+
+		#if defined (XNetDEBUG)
+		XNetSerial.print("XTX: 0x");
+		if (XNetSlaveMode == 0x00)  //MASTER-MODE
+			XNetSerial.print("1");
+		XNetSerial.print(CallByte, HEX);
+		for (byte i = 0; i < byteCount - 1; i++) {
+			if (pgm_read_byte(frame + i) < 0x10)
+				XNetSerial.print(" 0x0");
+			else XNetSerial.print(" 0x");
+			XNetSerial.print(pgm_read_byte(frame + i), HEX);
+		}
+		XNetSerial.println();
+		#endif
+		
+		if (!XNetTXReserve())
+			return;
+		
+		#if defined(XNetSlaveSupport)
+		if (CallByte == 0x00 && XNetSlaveMode != 0x00)
+			CallByte = XNetSlaveTag;	//SLAVE MODE: device of the paket
+		#endif
+		XNetTXBuffer.msg[XNetTXBuffer.put].data[XNetCallByte] = CallByte;	//patch the CallByte
+		XNetTXBuffer.msg[XNetTXBuffer.put].frame = frame;
+		XNetTXPublish(byteCount);
+}
+
+//--------------------------------------------------------------------------------------------
+// send a cached frame with priority, it is send before all waiting pakets of the Send Buffer
+void XpressNetMasterClass::XNetsendPrio(uint8_t CallByte, const uint8_t *frame, byte byteCount) {
+	if (XNetReplay)
+		return;	//replayTrace(): no answer on the bus
+	if (XNetTXPrio.msg[XNetTXPrio.put].length != 0x00) {	//Buffer is full?
+		XNetTXOverrun++;	//discard the new paket
+		#if defined (XNetDEBUG)
+		XNetSerial.println("XTX Prio Overrun!");
+		#endif
+		return;
+	}
+	#if defined (XNetDEBUG)
+	XNetSerial.print("XTX Prio: 0x");
+	XNetSerial.println(pgm_read_byte(frame), HEX);
+	#endif
+	XNetTXPrio.msg[XNetTXPrio.put].data[XNetCallByte] = CallByte;	//patch the CallByte
+	XNetTXPrio.msg[XNetTXPrio.put].frame = frame;
+	XNetTXPublishPrio(byteCount);
+}
+
+//--------------------------------------------------------------------------------------------
+// get the free priority message to write the paket direct into it
+uint8_t *XpressNetMasterClass::XNetTXReservePrio(uint8_t CallByte) {
+	if (XNetReplay)
+		return NULL;	//replayTrace(): no answer on the bus
+	if (XNetTXPrio.msg[XNetTXPrio.put].length != 0x00) {	//Buffer is full?
+		XNetTXOverrun++;	//discard the new paket
+		return NULL;
+	}
+	XNetTXPrio.msg[XNetTXPrio.put].data[XNetCallByte] = CallByte;
+	XNetTXPrio.msg[XNetTXPrio.put].frame = NULL;	//send the data
+	return XNetTXPrio.msg[XNetTXPrio.put].data;
+}
+
+//--------------------------------------------------------------------------------------------
+// add the XOR to the reserved priority message and send it out
+void XpressNetMasterClass::XNetTXCommitPrio(byte byteCount) {
+	getXOR(XNetTXPrio.msg[XNetTXPrio.put].data, byteCount);
+	XNetTXPublishPrio(byteCount);
+}
+
+//--------------------------------------------------------------------------------------------
+// publish the priority message at put to the running transmission
+void XpressNetMasterClass::XNetTXPublishPrio(byte byteCount) {
+	XNetTXPrioTime[XNetTXPrio.put] = micros();	//to measure the latency
+	XNetBarrier();	//all data is written,
+	XNetTXPrio.msg[XNetTXPrio.put].length = byteCount;	//now publish the message
+	XNetTXPrio.put = (XNetTXPrio.put + 1) & XNetTXPrio.mask;	//go to the next position
+}
+
+//--------------------------------------------------------------------------------------------
+// send a cached frame out of the receive interrupt, before all other pakets
+bool XpressNetMasterClass::XNetsendReply(uint8_t CallByte, const uint8_t *frame, byte byteCount) {
+	if (XNetTXReply.length != 0x00 || XNetReplay)
+		return false;	//there is already an answer for this window, or replayTrace()
+	XNetTXReply.data[XNetCallByte] = CallByte;	//patch the CallByte
+	XNetTXReply.frame = frame;
+	XNetTXReplyPublish(byteCount);
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------
+// publish the answer of the receive interrupt
+void XpressNetMasterClass::XNetTXReplyPublish(byte byteCount) {
+	XNetBarrier();	//all data is written,
+	XNetTXReply.length = byteCount;	//now publish the message
+	XNetTXStart();	//the bus is free, the device waits for the answer
+}
+
+#if defined(XNetFastReply)
+//--------------------------------------------------------------------------------------------
+//MASTER MODE: answer the stateless requests direct, update() only mark the slot
+bool XpressNetMasterClass::XNetFastAnswer(const XNetMessage *msg) {
+	uint8_t cmd = msg->data[XNetdata1];
+	if (msg->data[XNetheader] == 0x21) {
+		if (cmd == 0x21)	//Command station softwareversion
+			return XNetsendCachedReply(DirectedOps, XNetFrameVersion);
+		if (cmd == 0x24) {	//Command station status
+			switch (Railpower) {
+				case csNormal:			return XNetsendCachedReply(DirectedOps, XNetFrameStatusNormal);
+				case csServiceMode:		return XNetsendCachedReply(DirectedOps, XNetFrameStatusService);
+				case csShortCircuit:	return XNetsendCachedReply(DirectedOps, XNetFrameStatusShort);
+				default:				return XNetsendCachedReply(DirectedOps, XNetFrameStatusOff);
+			}
+		}
+	}
+	else if (msg->data[XNetheader] == 0xE3) {
+		if (cmd == 0x07)	//Funktionsstatus F0 bis F12 anfordern
+			return XNetsendCachedReply(DirectedOps, XNetFrameFktStatus);
+		#if defined(XNetExtFunctions)
+		if (cmd == 0x08)	//Funktionsstatus F13 bis F28 anfordern
+			return XNetsendCachedReply(DirectedOps, XNetFrameFktStatusHigh);
+		#endif
+	}
+	#if defined(XNetTrntStore)
+	else if ((msg->data[XNetheader] & 0xFE) == 0x42)	//Accessory Decoder information request
+		return XNetTrntAnswer(msg);
+	#endif
+	return false;	//answer in update()
+}
+#endif
+
+#if defined(XNetTrntStore)
+//--------------------------------------------------------------------------------------------
+//answer the information request 0x42 AAAA AAAA 1000 000N or 0x43 AH AL N out of the store
+bool XpressNetMasterClass::XNetTrntAnswer(const XNetMessage *msg) {
+	uint8_t len = msg->data[XNetheader] & 0x0F;	//1 or 2 address Byte
+	uint16_t Module = msg->data[XNetdata1];
+	if (len == 3)	//0x43
+		Module = (Module << 8) | msg->data[XNetdata2];
+	if (!XNetTrntOwn(Module) || XNetTXReply.length != 0x00 || XNetReplay)
+		return false;	//answer in update()
+	uint8_t *TrntInfo = XNetTXReply.data;
+	TrntInfo[XNetCallByte] = DirectedOps;
+	for (uint8_t i = XNetheader; i < XNetdata1 + len - 1; i++)
+		TrntInfo[i] = msg->data[i];	//header and address
+	TrntInfo[XNetdata1 + len - 1] = XNetTrntNibble(Module, msg->data[XNetdata1 + len - 1]);
+	getXOR(TrntInfo, len + 3);
+	XNetTXReply.frame = NULL;	//send the data
+	XNetTXReplyPublish(len + 3);
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------
+//save the position (P) of the turnout, MASTER MODE: broadcast the change
+void XpressNetMasterClass::XNetTrntSet(uint16_t Address, uint8_t P) {
+	uint16_t Module = Address >> 2;
+	if (Module >= (XNetTrntStore / 4))
+		return;
+	uint8_t shift = (Address & 0x03) * 2;
+	uint8_t Trnt = (XNetTrnt[Module] & ~(0x03 << shift)) | (((P & 0x01) ? 0x02 : 0x01) << shift);
+	if (Trnt == XNetTrnt[Module])
+		return;	//no change
+	XNetTrnt[Module] = Trnt;
+	if (XNetSlaveMode == 0x00 && Module <= 0xFF && XNetTrntOwn(Module)) {	//the feedback broadcast has only one address Byte
+		uint8_t N = (Address >> 1) & 0x01;
+		setBCFeedback(Module, XNetTrntNibble(Module, N));	//send with the next update()
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//position of the turnout: 0 = unknown, 1 = straight (P=0), 2 = thrown (P=1)
+uint8_t XpressNetMasterClass::getTrntPos(uint16_t Address) {
+	if ((Address >> 2) >= (XNetTrntStore / 4))
+		return 0;
+	return (XNetTrnt[Address >> 2] >> ((Address & 0x03) * 2)) & 0x03;
+}
+
+//--------------------------------------------------------------------------------------------
+//modules (Address >> 2) of the turnout decoders, only they are answered out of the store
+void XpressNetMasterClass::setTrntModules(uint16_t first, uint16_t count) {
+	if (first >= (XNetTrntStore / 4))
+		count = 0;
+	else if (count > (XNetTrntStore / 4) - first)
+		count = (XNetTrntStore / 4) - first;	//only inside the store
+	XNetTrntCount = 0;	//the receive interrupt see no half range
+	XNetBarrier();
+	XNetTrntFirst = first;
+	XNetBarrier();
+	XNetTrntCount = count;
+}
+#endif
+
 //--------------------------------------------------------------------------------------------
 // calculate the XOR
 void XpressNetMasterClass::getXOR (uint8_t *data, byte length) {
@@ -1206,92 +2732,188 @@ byte XpressNetMasterClass::callByteParity (byte me) {
 
 //--------------------------------------------------------------------------------------------
 #if defined(__AVR__)
-//Interrupt routine for writing via Serial
-#if defined(__AVR_ATmega8__)
-ISR(USART_TX_vect) {
-	XpressNetMasterClass::handle_TX_interrupt();	 //weiterreichen an die Funktion
-}
-#elif defined(SERIAL_PORT_0)
+//Interrupt routine for writing via Serial, only for the UARTs in XNetUARTs
+#if (XNetUARTs & (1 << 0))
+#if defined(USART0_TX_vect)
+	ISR(USART0_TX_vect) {
+#else
 	ISR(USART_TX_vect) {
-		XpressNetMasterClass::handle_TX_interrupt();	 //weiterreichen an die Funktion
+#endif
+		XpressNetMasterClass::handle_TX_interrupt<0>();	 //weiterreichen an die Funktion
 	}
-#else
+#endif
+#if (XNetUARTs & (1 << 1))
 	ISR(USART1_TX_vect) {
-		XpressNetMasterClass::handle_TX_interrupt();	 //weiterreichen an die Funktion
+		XpressNetMasterClass::handle_TX_interrupt<1>();	 //weiterreichen an die Funktion
+	}
+#endif
+#if (XNetUARTs & (1 << 2))
+	ISR(USART2_TX_vect) {
+		XpressNetMasterClass::handle_TX_interrupt<2>();	 //weiterreichen an die Funktion
+	}
+#endif
+#if (XNetUARTs & (1 << 3))
+	ISR(USART3_TX_vect) {
+		XpressNetMasterClass::handle_TX_interrupt<3>();	 //weiterreichen an die Funktion
 	}
 #endif
 
-// Interrupt handling for receive Data
+// Interrupt handling for send Data
 // static 
-inline void XpressNetMasterClass::handle_TX_interrupt()
+template<uint8_t UART> inline void XpressNetMasterClass::handle_TX_interrupt()
 {
-  if (active_object)
+  XpressNetMasterClass *object = active_object[UART];
+  if (object)
   {
-    active_object->XNetSendNext();	//nchste Byte Senden
+    object->XNetSendNext();	//nchste Byte Senden
   }
 }
 #endif
 
+#if defined(XNetHardwareUART)
+//--------------------------------------------------------------------------------------------
+//ESP32 UART interrupt for receive and send
+// static
+void XpressNetMasterClass::handle_UART_interrupt(void *arg)
+{
+	XpressNetMasterClass *object = (XpressNetMasterClass*)arg;
+	uint32_t status = uart_ll_get_intsts_mask(XNetUARTHW);
+	
+	if (status & (UART_INTR_RXFIFO_FULL | UART_INTR_PARITY_ERR)) {
+		//we receive with EVEN parity, a parity error means the 9th bit is not the even parity
+		bool ParityErr = status & UART_INTR_PARITY_ERR;
+		uart_ll_clr_intsts_mask(XNetUARTHW, UART_INTR_RXFIFO_FULL | UART_INTR_PARITY_ERR);
+		uint32_t waiting = uart_ll_get_rxfifo_len(XNetUARTHW);
+		if (ParityErr && waiting > 1) {
+			//the UART set the parity error when the byte was received, we don't know which byte it is
+			while (waiting-- > 0) {
+				uint8_t data = 0;
+				uart_ll_read_rxfifo(XNetUARTHW, &data, 1);
+			}
+			object->XNetRXResync();
+		}
+		//only one byte, the parity error is for the whole interrupt. A next byte in the FIFO raise a new interrupt (threshold 1).
+		else if (waiting > 0) {
+			uint8_t data = 0;
+			uart_ll_read_rxfifo(XNetUARTHW, &data, 1);
+			uint16_t data9 = data;
+			if (__builtin_parity(data) != ParityErr)
+				data9 |= 0x100;	//9th bit
+			object->XNetRXWord(data9);
+		}
+	}
+	if (status & UART_INTR_TX_DONE) {
+		uart_ll_clr_intsts_mask(XNetUARTHW, UART_INTR_TX_DONE);
+		object->XNetSendNext();	//nchste Byte Senden
+	}
+}
+
+#elif defined(XNetHost)
+//--------------------------------------------------------------------------------------------
+//Host build: the simulated bus calls this like the UART interrupt
+// static
+void XpressNetMasterClass::handle_Host_interrupt(void *arg, uint16_t data9)
+{
+	XpressNetMasterClass *object = (XpressNetMasterClass*)arg;
+	if (data9 == XNetHostTXDone)
+		object->XNetSendNext();	//nchste Byte Senden
+	else object->XNetRXWord(data9);
+}
+#endif
+
 //--------------------------------------------------------------------------------------------
 //Interrupt/Recusive Call-Back for the next data out
 void XpressNetMasterClass::XNetSendNext(void) {
 	if (XNetSlaveMode != 0x00 && XNetTXBuffer.pos == 0) {		//SLAVE MODE and Buffer is on the first byte
 		//STOP sending data, we are requested to send only one packet!
 		//nothing less to send out.
-		digitalWrite(MAX485_CONTROL, LOW); 	//RECEIVE_MODE
-		#if defined(ESP8266) || defined(ESP32)
+		XNetReceiveMode();
+		#if defined(XNetSoftwareSerial)
 			XNetSwSerial.enableTx(false);
 		#endif
+		XNetTXUnlock();
 		return;
 	}
 	XNetSendData();	//write next byte
 }
+
+//--------------------------------------------------------------------------------------------
+//start sending out the Buffer, if the transmission is not already running
+void XpressNetMasterClass::XNetTXStart(void) {
+	if (XNetReplay)
+		return;	//replayTrace(): the pakets wait until the end
+	#if defined(__AVR__)
+	uint8_t sreg = SREG;
+	cli();	//only to test and set the flag
+	bool busy = XNetTXBusy;
+	XNetTXBusy = true;
+	SREG = sreg;
+	#else
+	bool busy = __atomic_test_and_set((void*)&XNetTXBusy, __ATOMIC_ACQUIRE);
+	#endif
+	if (!busy)
+		XNetSendData();	//we are the only one that send now
+}
+
+//--------------------------------------------------------------------------------------------
+//the transmission is finished
+void XpressNetMasterClass::XNetTXUnlock(void) {
+	#if defined(__AVR__)
+	XNetTXBusy = false;
+	#else
+	__atomic_clear((void*)&XNetTXBusy, __ATOMIC_RELEASE);
+	#endif
+}
 	
 //--------------------------------------------------------------------------------------------
 //Function to start send data on the bus
 void XpressNetMasterClass::XNetSendData(void) {
-	uint16_t data9 = XNetReadBuffer();
+	uint16_t data9 = 0xFFFF;	//no data
+	if (XNetSlaveMode != 0x00 || XNetTXMsg != NULL || !(XNetTXLast & 0x100))	//MASTER MODE: after the CallByte the window is for the device
+		data9 = XNetReadBuffer();
 	
 	if (data9 > 0x1FF) {	//no data
 		//nothing less to send out.
-		digitalWrite(MAX485_CONTROL, LOW); 	//RECEIVE_MODE
-		#if defined(ESP8266) || defined(ESP32)
+		XNetReceiveMode();
+		#if defined(XNetSoftwareSerial)
 			XNetSwSerial.enableTx(false);
 		#endif
 		
+		if (XNetSlaveMode == 0x00 && (XNetTXLast & 0x100)) {	//MASTER MODE and last was a CallByte
+			XNetWindowTime = micros();	//the window for the device begins now
+			XSendCount = XNetWindowTime;	//wait the full window, the CallByte can be late behind other pakets
+			XNetWindowOpen = true;
+			XNetTXLast = 0;
+		}
+		XNetCallWait = false;	//the CallByte is out or was lost
+		XNetTXUnlock();
+		//was a new paket published while we stop?
+		if (XNetSlaveMode == 0x00 && !XNetWindowOpen && (XNetTXBuffer.msg[XNetTXBuffer.get].length != 0x00 || XNetTXPrio.msg[XNetTXPrio.get].length != 0x00))
+			XNetTXStart();
 		return;
 	}
 	
-	digitalWrite(MAX485_CONTROL, HIGH); 	//SEND_MODE
+	XNetSendMode();
+	XNetTXLast = data9;
+	#if defined(XNetStatistics)
+	XNetStatBytes++;
+	#endif
 	
 	#if defined(__AVR__)	
-		#ifdef __AVR_ATmega8__
-			/* wait for empty transmit buffer */
-			//while (!(UCSR0A & (1 << UDRE0))) {}
-			/* put the data into buffer, and send */
-			UCSRB &= ~(1 << TXB8);
-			if (data9 & 0x100) //is there a 9th bit?
-				UCSRB |= (1 << TXB8);
-			UDR = data9;
-		#elif defined(SERIAL_PORT_0)
-			/* wait for empty transmit buffer */
-			//while (!(UCSR0A & (1 << UDRE0))) {}
-			/* put the data into buffer, and send */
-			UCSR0B &= ~(1 << TXB80);
-			if (data9 & 0x100) //is there a 9th bit?
-				UCSR0B |= (1 << TXB80);
-			UDR0 = data9;
-		#else
-			/* wait for empty transmit buffer */
-			//while (!(UCSR1A & (1 << UDRE1))) {}
-			/* put the data into buffer, and send */
-			UCSR1B &= ~(1 << TXB81);
-			if (data9 & 0x100)	//is there a 9th bit?
-				UCSR1B |= (1 << TXB81);
-			UDR1 = data9;
-		#endif
+		XNetUARTWrite(data9);	//UART of this object
+		
+	#elif defined(XNetHardwareUART)
+		//9th bit as parity bit: EVEN if it is the same as the even parity of the data, else ODD
+		uint8_t data = data9 & 0xFF;
+		if (((data9 >> 8) & 0x01) == __builtin_parity(data))
+			uart_ll_set_parity(XNetUARTHW, UART_PARITY_EVEN);
+		else uart_ll_set_parity(XNetUARTHW, UART_PARITY_ODD);
+		uart_ll_write_txfifo(XNetUARTHW, &data, 1);	//TX done interrupt send the next byte
 		
-	#elif defined(ESP8266) || defined(ESP32)
+	#elif defined(XNetHost)
+		XNetHostWrite(data9);	//the simulated bus call back with XNetHostTXDone
+		
+	#elif defined(XNetSoftwareSerial)
 		
 		XNetSwSerial.enableTx(true);
 
@@ -1313,28 +2935,91 @@ void XpressNetMasterClass::XNetSendData(void) {
 	#endif
 }
 
+//--------------------------------------------------------------------------------------------
+//data byte of the actual send message, cached frames are read direct out of PROGMEM
+inline uint8_t XpressNetMasterClass::XNetTXData(uint8_t pos) {
+	const uint8_t *frame = XNetTXMsg->frame;
+	if ((frame != NULL) && (pos > XNetCallByte))
+		return pgm_read_byte(frame + pos - 1);
+	return XNetTXMsg->data[pos];
+}
+
+//--------------------------------------------------------------------------------------------
+//next paket of the Send Buffer, NULL = nothing to send
+XNetMessage *XpressNetMasterClass::XNetTXNext(void) {
+	uint8_t pos = XNetTXBuffer.get;
+	#if defined(XNetSlaveSupport)
+	if (XNetSlaveMode != 0x00) {	//SLAVE MODE: first paket for the window, the others don't block it
+		for (uint8_t i = 0; i <= XNetTXBuffer.mask; i++) {
+			if (XNetTXBuffer.msg[pos].length != 0x00) {
+				XNetBarrier();	//read the data after it was published
+				uint8_t tag = XNetTXBuffer.msg[pos].data[XNetCallByte];
+				if (tag == 0x00 || (tag & 0x1F) == XNetSlaveCall)
+					return &XNetTXBuffer.msg[pos];	//any device or the device of the window
+			}
+			pos = (pos + 1) & XNetTXBuffer.mask;
+		}
+		return NULL;	//wait for the window of the devices
+	}
+	#endif
+	if (XNetTXBuffer.msg[pos].length == 0x00)
+		return NULL;	//no data in Buffer!
+	XNetBarrier();	//read the data after it was published
+	return &XNetTXBuffer.msg[pos];
+}
+
 //--------------------------------------------------------------------------------------------
 uint16_t XpressNetMasterClass::XNetReadBuffer() {
-	if (XNetTXBuffer.msg[XNetTXBuffer.get].length == 0x00)
-		return 0xFFFF;	//no data in Buffer!
+	if (XNetTXMsg == NULL) {	//start with the next message, priority first
+		if (XNetTXReply.length != 0x00) {
+			XNetBarrier();	//read the data after it was published
+			XNetTXMsg = &XNetTXReply;	//answer in the actual window
+		}
+		else if (XNetTXPrio.msg[XNetTXPrio.get].length != 0x00) {
+			XNetBarrier();	//read the data after it was published
+			XNetTXMsg = &XNetTXPrio.msg[XNetTXPrio.get];
+			unsigned long wait = micros() - XNetTXPrioTime[XNetTXPrio.get];
+			if (wait > XNetPrioLatency)
+				XNetPrioLatency = wait;	//worst case
+		}
+		else {
+			XNetTXMsg = XNetTXNext();
+			if (XNetTXMsg == NULL)
+				return 0xFFFF;	//no data in Buffer!
+		}
+	}
 	
-	uint16_t data = XNetTXBuffer.msg[XNetTXBuffer.get].data[XNetTXBuffer.pos];
+	uint16_t data = XNetTXData(XNetTXBuffer.pos);
 	if (XNetTXBuffer.pos == 0x00) {	//it is a CALLBYTE and we are MASTER!
-		if (data != 0x00) 
+		if (data != 0x00 && XNetSlaveMode == 0x00) 
 			data |= 0x100;	//add 9th bit
 		else { //no callbyte!
 			XNetTXBuffer.pos++;	//skip first byte
-			data = XNetTXBuffer.msg[XNetTXBuffer.get].data[XNetTXBuffer.pos];	//read the next!
+			data = XNetTXData(XNetTXBuffer.pos);	//read the next!
 		}
 	}
 
+	#if defined(XNetTrace)
+	XNetTraceAdd(data | XNetTraceTX);
+	#endif
+	
 	XNetTXBuffer.pos++;	//next data byte to send
-	if (XNetTXBuffer.pos >= XNetTXBuffer.msg[XNetTXBuffer.get].length) {	//any byte left to send?
+	if (XNetTXBuffer.pos >= XNetTXMsg->length) {	//any byte left to send?
 		XNetTXBuffer.pos = 0;	//Reset data counter
-		XNetTXBuffer.msg[XNetTXBuffer.get].length = 0x00; //Reset Bufferstore
-		XNetTXBuffer.get++;	//go to the next message
-		if (XNetTXBuffer.get >= XNetBufferSize)	//overflow?
-			XNetTXBuffer.get = 0;	//start from the first value
+		XNetMessage *done = XNetTXMsg;
+		if (done == &XNetTXPrio.msg[XNetTXPrio.get])
+			XNetTXPrio.get = (XNetTXPrio.get + 1) & XNetTXPrio.mask;	//go to the next message
+		else if (done == &XNetTXBuffer.msg[XNetTXBuffer.get]) {
+			XNetTXBuffer.get = (XNetTXBuffer.get + 1) & XNetTXBuffer.mask;
+			#if defined(XNetSlaveSupport)
+			uint8_t put = XNetTXBuffer.put;
+			while (XNetTXBuffer.get != put && XNetTXBuffer.msg[XNetTXBuffer.get].length == 0x00)
+				XNetTXBuffer.get = (XNetTXBuffer.get + 1) & XNetTXBuffer.mask;	//SLAVE MODE: already send before
+			#endif
+		}
+		XNetTXMsg = NULL;
+		XNetBarrier();
+		done->length = 0x00; //Reset Bufferstore, free for new data
 	}
 	
 	return data;
@@ -1344,145 +3029,138 @@ uint16_t XpressNetMasterClass::XNetReadBuffer() {
 //Interrupt reading data!	
 //--------------------------------------------------------------------------------------------
 //--------------------------------------------------------------------------------------------
-//Interrupt routine for reading via Serial
-#ifdef __AVR_ATmega8__
-ISR(USART_RX_vect)  {
-	XpressNetMasterClass::handle_RX_interrupt();	 //weiterreichen an die Funktion
-}
-#elif defined(SERIAL_PORT_0)
-	ISR(USART_RX_vect)  {
-		XpressNetMasterClass::handle_RX_interrupt();	 //weiterreichen an die Funktion
-	}
-
+//Interrupt routine for reading via Serial, only for the UARTs in XNetUARTs
+#if (XNetUARTs & (1 << 0))
+#if defined(USART0_RX_vect)
+	ISR(USART0_RX_vect) {
 #else
+	ISR(USART_RX_vect) {
+#endif
+		XpressNetMasterClass::handle_RX_interrupt<0>();	 //weiterreichen an die Funktion
+	}
+#endif
+#if (XNetUARTs & (1 << 1))
 	ISR(USART1_RX_vect) {
-		XpressNetMasterClass::handle_RX_interrupt();	 //weiterreichen an die Funktion
+		XpressNetMasterClass::handle_RX_interrupt<1>();	 //weiterreichen an die Funktion
+	}
+#endif
+#if (XNetUARTs & (1 << 2))
+	ISR(USART2_RX_vect) {
+		XpressNetMasterClass::handle_RX_interrupt<2>();	 //weiterreichen an die Funktion
+	}
+#endif
+#if (XNetUARTs & (1 << 3))
+	ISR(USART3_RX_vect) {
+		XpressNetMasterClass::handle_RX_interrupt<3>();	 //weiterreichen an die Funktion
 	}
 #endif
 
 // Interrupt handling for receive Data
 // static 
-inline void XpressNetMasterClass::handle_RX_interrupt()
+template<uint8_t UART> inline void XpressNetMasterClass::handle_RX_interrupt()
 {
-  if (active_object)
+  uint16_t data9 = XNetUSARTRead<UART>();	//read always, this clears the interrupt
+  XpressNetMasterClass *object = active_object[UART];
+  if (object)
   {
-	active_object->XNetReceive();	//Byte lesen
+	object->XNetRXWord(data9);	//Byte speichern
   }
 }
 #endif
 
+#if defined(XNetSoftwareSerial)
 //--------------------------------------------------------------------------------------------
 //Serial einlesen:
 void XpressNetMasterClass::XNetReceive(void)
 {
-	#if defined(__AVR__)	
+	uint16_t data9 = 0;		//9 bit data
+	if (XNetSwSerial.available()) {      // If anything comes in Serial
+		data9 = XNetSwSerial.read();
+		if (XNetSwSerial.readParity())    //detect parity bit set on the last message (MARK parity)
+			data9 |= 0x100;
+		#if defined (XNetDEBUG)
+		else {
+			XNetSerial.print(XNetRXBuffer.msg[XNetRXBuffer.put].length+1);
+			XNetSerial.print("-");
+			XNetSerial.print(data9, HEX);
+			XNetSerial.print(" ");
+		}
+		#endif
+	}
+	else return;
+	
+	XNetRXWord(data9);
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+//Speichern der eingelesenen 9 bit Daten:
+void XpressNetMasterClass::XNetRXWord(uint16_t data9)
+{
+	#if defined(XNetTrace)
+	if (!XNetReplay)	//don't record the replay again
+		XNetTraceAdd(data9);
+	#endif
+	
+	XNetMessage *msg = &XNetRXBuffer.msg[XNetRXBuffer.put];	//read the position only once
+	if (data9 & 0x100) {	//9th bit: CallByte
+		msg->length = 0;	//clear - only for sync!
+		msg->data[XNetCallByte] = data9 & 0xFF;
 		
-		// if there's any serial available, read it:
-		#ifdef __AVR_ATmega8__
-			// Filter the 9th bit, then return 
-			if (UCSRB & (1 << RXB8)) {
-				//XNetMsgCallByte = UDR;	//only store data
-				XNetRXBuffer.msg[XNetRXBuffer.put].length = 0;	//clear - only for sync!
-				XNetRXBuffer.msg[XNetRXBuffer.put].data[XNetCallByte] = UDR;
-				
-				if (XNetSlaveMode != 0x00)	//we are already a slave!
-					XNetSlaveMode = XNetSlaveCycle;	//reactivate SLAVE MODE
-				
-				if (XNetRXBuffer.msg[XNetRXBuffer.put].data[XNetCallByte] == MY_ADDRESS) {
-					XNetSlaveMode = XNetSlaveCycle;	//reactivate SLAVE MODE
-					XNetSendData();	//start sending out by interrupt
-				}
-			}
-			else {
-				XNetRXBuffer.msg[XNetRXBuffer.put].length++;	    //weitere Nachrichtendaten
-				XNetRXBuffer.msg[XNetRXBuffer.put].data[XNetRXBuffer.msg[XNetRXBuffer.put].length] = UDR;                   // Zeichen aus UDR an Aufrufer zurueckgeben
-			}
-		#elif defined(SERIAL_PORT_0)
-			// Filter the 9th bit, then return 
-			if (UCSR0B & (1 << RXB80)) {
-				//XNetMsgCallByte = UDR0;	//only store data
-				XNetRXBuffer.msg[XNetRXBuffer.put].length = 0;	//clear - only for sync!
-				XNetRXBuffer.msg[XNetRXBuffer.put].data[XNetCallByte] = UDR0;
-				
-				if (XNetSlaveMode != 0x00)	//we are already a slave!
-					XNetSlaveMode = XNetSlaveCycle;	//reactivate SLAVE MODE
-				
-				if (XNetRXBuffer.msg[XNetRXBuffer.put].data[XNetCallByte] == MY_ADDRESS) {
-					XNetSlaveMode = XNetSlaveCycle;	//reactivate SLAVE MODE
-					XNetSendData();	//start sending out by interrupt
-				}
-			}
-			else {
-				XNetRXBuffer.msg[XNetRXBuffer.put].length++;	    //weitere Nachrichtendaten
-				XNetRXBuffer.msg[XNetRXBuffer.put].data[XNetRXBuffer.msg[XNetRXBuffer.put].length] = UDR0;                   // Zeichen aus UDR an Aufrufer zurueckgeben
-			}
-		#else
-			// Filter the 9th bit, then return 
-			if (UCSR1B & (1 << RXB81)) {
-				//XNetMsgCallByte = UDR1;	//only store data
-				XNetRXBuffer.msg[XNetRXBuffer.put].length = 0;	//clear - only for sync!
-				XNetRXBuffer.msg[XNetRXBuffer.put].data[XNetCallByte] = UDR1;
-				
-				if (XNetSlaveMode != 0x00)	//we are already a slave!
-					XNetSlaveMode = XNetSlaveCycle;	//reactivate SLAVE MODE
-				
-				if (XNetRXBuffer.msg[XNetRXBuffer.put].data[XNetCallByte] == MY_ADDRESS) {
-					XNetSlaveMode = XNetSlaveCycle;	//reactivate SLAVE MODE
-					XNetSendData();	//start sending out by interrupt
-				}
-			}
-			else {
-				XNetRXBuffer.msg[XNetRXBuffer.put].length++;	    //weitere Nachrichtendaten
-				XNetRXBuffer.msg[XNetRXBuffer.put].data[XNetRXBuffer.msg[XNetRXBuffer.put].length] = UDR1;                   // Zeichen aus UDR an Aufrufer zurueckgeben
-			}
+		#if defined(XNetSlaveSupport)
+		if (XNetSlaveMode != 0x00)	//we are already a slave!
+			XNetSlaveMode = XNetSlaveCycle;	//reactivate SLAVE MODE
+		
+		if (XNetSlaveOwn(data9 & 0xFF, 0x40)) {	//one of our devices, default 0x15F
+			XNetSlaveMode = XNetSlaveCycle;	//reactivate SLAVE MODE
+			XNetSlaveCall = data9 & 0x1F;	//send only the pakets of this device
+			XNetTXStart();	//start sending out by interrupt
+		}
+		#if defined(XNetFastReply)
+		else if (XNetSlaveMode != 0x00 && XNetSlaveOwn(data9 & 0xFF, 0x00))	//Central Station ask client for ACK?
+			XNetsendCachedReply(0x00, XNetFrameAck);	//direct after the CallByte
 		#endif
-	#elif defined(ESP8266) || defined(ESP32)
-		if (XNetSwSerial.available()) {      // If anything comes in Serial
-			uint8_t data = XNetSwSerial.read();
-			if (XNetSwSerial.readParity()) {   //detect parity bit set on the last message (MARK parity)
-				XNetRXBuffer.msg[XNetRXBuffer.put].length = 0;	//clear - only for sync!
-				XNetRXBuffer.msg[XNetRXBuffer.put].data[XNetCallByte] = data;
-				
-				if (XNetSlaveMode != 0x00)	//we are already a slave!
-					XNetSlaveMode = XNetSlaveCycle;	//reactivate SLAVE MODE
-				
-				if (XNetRXBuffer.msg[XNetRXBuffer.put].data[XNetCallByte] == MY_ADDRESS) { //0x15F
-					XNetSlaveMode = XNetSlaveCycle;	//reactivate SLAVE MODE
-					XNetSendData();	//start sending out by interrupt
-				}
+		#endif
+		#if defined(XNetHardwareUART)
+		XNetRXDrop = false;	//in sync again
+		#endif
+	}
+	#if defined(XNetHardwareUART)
+	else if (XNetRXDrop && XNetRXSync == 0x00) {
+		//wait for the next CallByte
+	}
+	#endif
+	else {
+		#if defined(XNetHardwareUART)
+		XNetRXDrop = false;	//MASTER MODE: next window
+		#endif
+		XNetRXData(msg, data9);	//weitere Nachrichtendaten
+	}
+	
+	uint8_t len = msg->length;
+	if (len >= 2) { // header and one data byte or more received
+		//Check length - length is inside header but without header and xor!
+		if (XNetRXNeed == len) {	//reach defined data length + Header and CRC?
+			msg->xorOK = (XNetRXXor == 0x00);
+			msg->answered = false;
+			if (XNetSlaveMode == 0x00) {	//MASTER MODE
+				if (!msg->xorOK)
+					XNetsendCachedReply(DirectedOps, XNetFrameTransferErr);	//bertragungsfehler, still in the window
+				#if defined(XNetFastReply)
+				else msg->answered = XNetFastAnswer(msg);
+				#endif
+			}
+			uint8_t next = (XNetRXBuffer.put + 1) & XNetRXBuffer.mask;	//next message data
+			if (next == XNetRXBuffer.get) {	//Buffer is full?
+				XNetRXOverrun++;	//discard the new paket
+				msg->length = 0;
 			}
 			else {
-				#if defined (XNetDEBUG)
-					XNetSerial.print(XNetRXBuffer.msg[XNetRXBuffer.put].length+1);
-					XNetSerial.print("-");
-					XNetSerial.print(data, HEX);
-					XNetSerial.print(" ");
-				#endif
-				
-				XNetRXBuffer.msg[XNetRXBuffer.put].length++;	    //weitere Nachrichtendaten
-				XNetRXBuffer.msg[XNetRXBuffer.put].data[XNetRXBuffer.msg[XNetRXBuffer.put].length] = data;                   // Zeichen aus UDR an Aufrufer zurueckgeben
+				XNetBarrier();	//all data is written,
+				XNetRXBuffer.put = next;	//now publish the message
 			}
-			
-		}
-		else return;
-	#endif	
-	
-	if (XNetRXBuffer.msg[XNetRXBuffer.put].length >= 2) { // header and one data byte or more received
-		//Check length - length is inside header but without header and xor!
-		if (((XNetRXBuffer.msg[XNetRXBuffer.put].data[XNetheader] & 0x0F) + 2 ) == XNetRXBuffer.msg[XNetRXBuffer.put].length) {	//reach defined data length + Header and CRC?
-			/*
-			#if defined (XNetDEBUG)
-					XNetSerial.print(XNetRXBuffer.put);
-					XNetSerial.print(" New-");
-					XNetSerial.println(XNetRXBuffer.msg[XNetRXBuffer.put].data[XNetheader] & 0x0F);
-			#endif		
-			*/
-			XNetRXBuffer.put++;	//next message data
-			if (XNetRXBuffer.put >= XNetBufferSize)	//at the end of the buffer?
-				XNetRXBuffer.put = 0;
-			
 		}
-		if ((XNetRXBuffer.msg[XNetRXBuffer.put].length) >= XNetBufferMaxData ) {	//overflow, without length byte!!!
+		else if (len >= XNetBufferMaxData) {	//overflow, without length byte!!!
 			XNetRXclear(XNetRXBuffer.put); 	//clear!
 			
 			#if defined (XNetDEBUG)
@@ -1491,23 +3169,52 @@ void XpressNetMasterClass::XNetReceive(void)
 		}	
 	}
 	
+	#if defined(XNetStatistics)
+	XNetStatBytes++;
+	if (XNetWindowOpen) {	//first byte of the answer
+		XNetSlotStats *stat = &XNetStat.slot[DirectedOps & 0x1F];
+		unsigned long wait = micros() - XNetWindowTime;
+		uint16_t latency = (wait > 0xFFFF) ? 0xFFFF : wait;
+		if (latency < stat->latencyMin)
+			stat->latencyMin = latency;
+		if (latency > stat->latencyMax)
+			stat->latencyMax = latency;
+		if (stat->latencyAvg == 0)
+			stat->latencyAvg = latency;	//first value
+		else stat->latencyAvg = stat->latencyAvg - (stat->latencyAvg / 8) + (latency / 8);	//floating average
+	}
+	#endif
+	
+	XNetWindowOpen = false;	//the device is answering
 	XSendCount = micros(); //save time last Data on Bus!
 }
 
+//--------------------------------------------------------------------------------------------
+//add a data byte to the RX Message
+void XpressNetMasterClass::XNetRXData(XNetMessage *msg, uint8_t data)
+{
+	uint8_t len = msg->length + 1;	//weitere Nachrichtendaten
+	if (XNetRXSync != 0x00) {	//first byte after our CallByte (MASTER MODE)
+		msg->data[XNetCallByte] = XNetRXSync;
+		XNetRXSync = 0x00;
+		len = 1;	//clear - only for sync!
+	}
+	if (len == 1) {	//Header
+		XNetRXXor = data;
+		XNetRXNeed = (data & 0x0F) + 2;	//Header, data and XOR
+	}
+	else XNetRXXor ^= data;
+	if (len < XNetBufferMaxData)
+		msg->data[len] = data;
+	msg->length = len;
+}
+
 //--------------------------------------------------------------------------------------------
 //Lschen des letzten gesendeten Befehls
 void XpressNetMasterClass::XNetRXclear(uint8_t b)
 {
 	
-	//Reset Message
+	//Reset Message, the data is written new with the length
 	XNetRXBuffer.msg[b].length = 0;
 	XNetRXBuffer.msg[b].data[XNetCallByte] = 0x00;
-	XNetRXBuffer.msg[b].data[XNetheader] = 0x00;
-	XNetRXBuffer.msg[b].data[XNetdata1] = 0x00;
-	XNetRXBuffer.msg[b].data[XNetdata2] = 0x00;
-	XNetRXBuffer.msg[b].data[XNetdata3] = 0x00;
-	XNetRXBuffer.msg[b].data[XNetdata4] = 0x00;
-	XNetRXBuffer.msg[b].data[XNetdata5] = 0x00;
-	XNetRXBuffer.msg[b].data[XNetdata6] = 0x00;
-	XNetRXBuffer.msg[b].data[XNetdata7] = 0x00;
 }
@@ -34,6 +34,36 @@
 	- add support for XpressNet v4.0 with switch up to 2048
 	- fix SWSERIAL_PARITY_MARK to PARITY_MARK because they change the name!
 	- remove blocking Interrups while tx on ESP8266 and ESP32
+	- add slot scheduler, call active slots more often then idle slots
+	- add fast advance to the next slot when the device is silent
+	- add power of two RX/TX Buffer size with overrun counter
+	- make RX/TX Buffer safe between interrupt and main loop (single producer/single consumer)
+	- add ESP32 hardware UART with RS485 direction control by RTS
+	- change decode of received pakets into sorted dispatch tables
+	- add cached constant reply frames in PROGMEM with XOR calculated by the compiler
+	- build the send pakets direct inside the Send Buffer (reserve and commit)
+	- collect feedback and send up to 3 Adr/Data pairs in one broadcast paket
+	- add optional loco state cache to answer the loco info requests direct
+	- add loco owner hash, busy messages without scan over all slots
+	- add priority Send Buffer for the power and emergency stop pakets
+	- add optional statistics for each slot and the bus load
+	- add optional binary bus trace with replay into the decoder
+	- add host build (PC) with a simulated bus for throughput benchmarks
+	- add more than one XpressNet bus, each on its own UART, the locos are shared
+	- AVR UART register as template policy, the RX interrupt use fixed addresses
+	- check XOR and length while receive, send the transfer error direct in the window
+	- answer status, version, function mode and ACK direct out of the receive interrupt
+	- CV programming as job for each throttle, send the result direct to the requesting slot
+	- function groups up to F68 in the loco cache, setFuncGroup() send only changed groups
+	- emergency stop a locomotive (0x92 and 0x91) with notifyXNetLocoEmStop, busy to the driver with priority
+	- DCC fast clock: MASTER send it each model minute in a free window, SLAVE with notifyXNetFastClock
+	- turnout store with 2 bit for each turnout, answer the information request without notifyXNetTrntInfo
+	  only for the modules set with setTrntModules(), the others (e.g. feedback) still go to notifyXNetTrntInfo
+	- SLAVE: queue for getLocoInfo() and getLocoFkt(), one request on the bus until the answer, with timeout and repeat
+	- SLAVE: device address at runtime with setSlaveAddress(), more devices in one instance with addSlaveAddress()
+	- timeUntilNextDeadline() and notifyXNetIdle for background work without missing a window
+	- power save: slow polling when no paket is received and no throttle drive a loco
+	- feature switches to remove SLAVE MODE, Service Mode, F13-F68 and the busy tracker, RAM in README.md
 */
 
 // ensure this library description is only included once
@@ -68,12 +98,48 @@
 #undef SERIAL_PORT_1
 #endif
 
+#if defined(SERIAL_PORT_1)
+#define XNetUARTDefault 1	//setup() without UART
+#elif defined(__AVR__) && !defined(UCSR0A) && !defined(UCSRA)
+#define XNetUARTDefault 1	//only UART1 (ATmega32U4)
+#else
+#define XNetUARTDefault 0
+#endif
+#define XNetMaxUART 4	//MEGA: UART 0..3
+//UARTs with an interrupt handler in this library, bit n = UARTn (Serial1, Serial2, ... of the sketch can't use them!):
+#define XNetUARTs (1 << XNetUARTDefault)	//MEGA with three bus: ((1 << 1) | (1 << 2) | (1 << 3))
+
+//--------------------------------------------------------------------------------------------
+//ESP32: use a hardware UART instead of SoftwareSerial
+//#define XNetESP32UART 2	//UART number, the 9th bit is send as parity bit
+
+#if defined(ESP32) && defined(XNetESP32UART)
+#define XNetHardwareUART	//ESP32 hardware UART with interrupt
+#elif defined(ESP8266) || defined(ESP32)
+#define XNetSoftwareSerial	//ESP SoftwareSerial, read out in update()
+#endif
+
+//--------------------------------------------------------------------------------------------
+//Host build (PC) with a simulated bus, see extras/host:
+//#define XNetHost	//set by the compiler with -DXNetHost
+#if defined(XNetHost)
+extern void XNetHostWrite(uint16_t data9);	//simulated bus: send the 9 bit data, then call handle_Host_interrupt() with XNetHostTXDone
+#define XNetHostTXDone 0xFFFF	//handle_Host_interrupt(): the last byte is out
+#endif
+
 //--------------------------------------------------------------------------------------------
 //only for Debug:
 //#define XNetSerial Serial	//Debugging Serial
 //#define XNetDEBUG		//Put out the messages
 //#define XNetDEBUGTime	//Put out the microseconds
 
+//--------------------------------------------------------------------------------------------
+//Features, comment out to remove the code and the RAM (numbers in README.md):
+#define XNetSlaveSupport	//SLAVE MODE behind another Central Station
+#define XNetServiceMode		//CV programming in Direct Mode (0x22 0x15, 0x23 0x16, 0x21 0x10)
+#define XNetExtFunctions	//function groups F13 to F68, without only F0 to F12
+#define XNetBusyTracker		//loco owner of each slot, the old driver gets busy
+
 
 //--------------------------------------------------------------------------------------------
 /*An XpressNet device designed to work with XpressNet V3 and later systems must be designed so that it 
@@ -84,14 +150,71 @@ difference is to provide a design tolerance between the different types of devic
 Under normal conditions an XpressNet device must be designed to be able to handle the receipt of its 
 next transmission window between 400 microseconds and 500 milliseconds after the receipt of the last window.  */
 
-#if defined(ESP8266) || defined(ESP32)
+#if defined(XNetSoftwareSerial)
+#include <SoftwareSerial.h>
 #define XNetTransmissionWindow 3000	//wait longer = slower, because software serial interrupt
+#define XNetResponseTimeout 500		//max time after the CallByte until the first byte is read
 #else
 #define XNetTransmissionWindow 500	//max time to wait until data will be received
+#define XNetResponseTimeout 300		//max time after the CallByte until the first byte is read (start in 120 + one byte)
 #endif
+#define XNetFastAdvance		//go to the next slot when the device don't answer in XNetResponseTimeout
+#define XNetFastReply		//answer stateless requests in the receive interrupt, independent of the loop() time
+#define XNetIdleMin 100		//min s until the next CallByte to call notifyXNetIdle() out of update()
+
+//Slot scheduler for the CallByte windows:
+#define XNetActiveWeight 2		//extra windows for active slots after each normal slot
+#define XNetActiveTime 30		//time x 100ms a slot stays active after the last paket (3 sec)
+#define XNetDiscoveryRounds 8	//every N rounds call also the unused slots (discovery)
+
+//Power save, slow polling when no loco is in use and no paket is received (MASTER MODE):
+//#define XNetPowerSave 60000		//ms without paket, then start the slow polling; sleep in notifyXNetIdle()
+#define XNetPowerSavePoll 15000		//s between the CallBytes, all rounds are discovery rounds: 31 slots * 15 ms < 500 ms for each device
+
+//Loco owner hash (loco address to slot), must be a power of two and > 31:
+#define XNetOwnerSize 64
+
+//XpressNet Buffer length (send and receive), must be a power of two:	
+#define XNetBufferSize 8	//max Data Pakets (max: 4 Bit = 16!)
+#define XNetRXBufferSize XNetBufferSize		//Read Buffer
+#define XNetTXBufferSize XNetBufferSize		//Send Buffer
+#define XNetTXPrioSize 4	//priority Send Buffer for setPower(), send before the Send Buffer
+
+//A full Send Buffer or Read Buffer discard the new paket, see getTXOverrun() and getRXOverrun().
+
+//Feedback broadcast, collect the changes until the next update():
+#define XNetFeedbackBuffer 12	//max Adr/Data pairs that wait, 0 = send each pair direct
+#define XNetFeedbackPairs 3		//max pairs in one paket (0x46 = 6 data bytes)
+
+//CV programming (Direct Mode), one job for each throttle, the sketch work on them in order:
+#define XNetCVJobs 4			//max throttles with a CV read or write at the same time
+#define XNetCVTimeout 8000		//ms for the sketch to answer with setCVReadValue() or setCVNack(), then "no ACK"
+
+//SLAVE MODE: loco info and function requests, only one waits for the answer of the central station:
+#define XNetSlaveRequests 8		//max requests in the queue
+#define XNetSlaveReqTimeout 500	//ms for the answer, then repeat the request
+#define XNetSlaveReqRetry 2		//max repeats, then the request is dropped
+
+//DCC fast clock 0x05 0xF1, MASTER: start it with setFastClock():
+#define XNetFastClock
+
+//Turnout store, 2 bit position for each turnout, answer the information requests (0x42/0x43) direct:
+//#define XNetTrntStore 2048	//number of turnouts (4 in one Byte: 2048 = 512 Byte)
+//only for the turnout decoder modules set with setTrntModules(), feedback modules go to notifyXNetTrntInfo
 
-//XpressNet Buffer length (send and receive):	
-#define XNetBufferSize 5	//max Data Pakets (max: 4 Bit = 16!)
+//Loco state cache, answer the loco info requests without notifyXNetgiveLoco*:
+//#define XNetLocoCache 8		//number of locos in the cache, feeded by the drive and function commands
+
+//Statistics for each slot and the bus, read out with getStats() (MASTER MODE):
+//#define XNetStatistics	//needs 14 Byte RAM for each slot (448 Byte)
+#define XNetByteTime 176	//time of one byte on the bus in s (11 bit with 62.5 kBaud)
+
+//Bus trace, binary record of all 9 bit data in a RAM ring, read out with readTrace():
+//#define XNetTrace 64	//entries (4 Byte each), must be a power of two
+/* Trace file format (e.g. from the XpressNet_Trace example, replay on the PC with extras/host/XNetReplay.cpp):
+ *   "XNT1" and then each entry with 4 Byte little endian: delta (s, uint16), data (uint16)
+ *   data: bit 0..8 = 9 bit data on the bus, XNetTraceTX = send by this device */
+#define XNetTraceTX 0x8000
 
 //XpressNet Mode (Master/Slave)
 #define XNetSlaveCycle 0xFF	//max (255) cycles to Stay in SLAVE MODE when no CallByte is received
@@ -101,12 +224,17 @@ next transmission window between 400 microseconds and 500 milliseconds after the
 #define Loco27 0x01		//FFF = 001 = 27 speed step
 #define Loco28 0x02		//FFF = 010 = 28 speed step
 #define Loco128 0x04	//FFF = 100 = 128 speed step
+#if defined(XNetExtFunctions)
+#define XNetFuncGroups 10	//function groups 1..10 = F0 to F68
+#else
+#define XNetFuncGroups 3	//function groups 1..3 = F0 to F12
+#endif
 
 // XPressnet Call Bytes.
 // broadcast to everyone, we save the incoming data and process it later.
 #define GENERAL_BROADCAST 0x60	//0x160
 #define FB_BROADCAST 0xA0		//0x1A0
-#define MY_ADDRESS 0x5F	//only for SLAVE-MODE Adr=31 (0x5F) or Adr=26 (0x5A)!
+#define MY_ADDRESS 0x5F	//only for SLAVE-MODE Adr=31 (0x5F), default of setSlaveAddress()
 
 #define ACK_REQ 0x9A	//Acknowledge-Anforderungen beantworten mit 0x20 0x20
 
@@ -131,19 +259,133 @@ next transmission window between 400 microseconds and 500 milliseconds after the
 
 #define XNetBufferMaxData 10		//max Bytes over all for each Paket
 
+/* Thread model of the RX/TX Buffer (single producer/single consumer):
+ * Read Buffer: only the receive (RX interrupt on AVR, update() on ESP) writes 'put' and the
+ *   message at 'put'. A paket is published with 'put' after all bytes are written.
+ *   Only update() reads the pakets and writes 'get'.
+ * Send Buffer: only the main context (update() and the public functions) writes 'put' and
+ *   the message at 'put'. A paket is published with its 'length' after all data bytes are written.
+ *   Only the running transmission (TX interrupt on AVR) reads the pakets, 'pos' and 'get' and 
+ *   releases a message by clearing its 'length'. The transmission is started by XNetTXStart(),
+ *   a flag makes sure that it runs only in one context at the same time.
+ *   The priority Send Buffer works the same way, the transmission takes its pakets first.
+ * Call update() and the public functions only from one task! */
+#if defined(ESP8266) || defined(ESP32)
+#define XNetBarrier() __sync_synchronize()	//write data before publish it
+#else
+#define XNetBarrier() __asm__ __volatile__ ("" ::: "memory")	//write data before publish it
+#endif
+
 typedef struct	//Msg Seicher
 {
-	uint8_t length;			//Speicher fr Datenlnge
+	volatile uint8_t length;			//Speicher fr Datenlnge
 	uint8_t data[XNetBufferMaxData];	//zu sendende Daten
+	const uint8_t *frame;				//cached frame in PROGMEM after the CallByte, NULL = use data
+	bool xorOK;							//RX: XOR of the paket is right, checked while receive
+	bool answered;						//RX: the receive interrupt has already send the answer
 } XNetMessage;
 
-typedef struct	//Buffer
+template <uint8_t Size>
+struct XNetBuffer	//Buffer
 {
-	XNetMessage msg[XNetBufferSize];
-	uint8_t get;	//position we are with reading
-	uint8_t put;	//position we are with writing
+	static_assert((Size >= 2) && (Size <= 16) && ((Size & (Size - 1)) == 0), "XpressNet Buffer size must be a power of two (2..16)");
+	static const uint8_t mask = Size - 1;	//wrap the position
+	XNetMessage msg[Size];
+	volatile uint8_t get;	//position we are with reading
+	volatile uint8_t put;	//position we are with writing
 	uint8_t pos;	//byte position for write
-} XNetBuffer;
+};
+
+typedef struct	//decoded RX paket
+{
+	uint8_t *data;		//raw data of the paket, index with XNetheader, XNetdata1, ...
+	uint8_t header;		//Header
+	uint8_t cmd;		//Databyte1
+	uint16_t adr;		//loco address of Databyte2 and Databyte3
+} XNetFrame;
+
+class XpressNetMasterClass;
+typedef void (XpressNetMasterClass::*XNetHandler)(uint8_t param);
+
+#define XNetAnyCmd 0xFF		//dispatch entry for all other Databyte1
+#define XNetOnlyMaster 0x01	//dispatch entry only in MASTER MODE
+#define XNetMarkSlot 0x02	//mark the Slot as activ after the handler
+
+typedef struct	//dispatch entry, tables are sorted by header and cmd!
+{
+	uint8_t header;		//Header
+	uint8_t cmd;		//Databyte1 or XNetAnyCmd
+	uint8_t flags;		//XNetOnlyMaster, XNetMarkSlot
+	uint8_t param;		//value for the handler
+	XNetHandler handler;
+} XNetDispatch;
+
+typedef struct	//loco state in the cache
+{
+	uint16_t adr;		//loco address, 0 = free
+	uint8_t steps;		//Loco14, Loco27, Loco28, Loco128
+	uint8_t speed;		//RVVV VVVV like on the XpressNet
+	uint8_t func[XNetFuncGroups - 1];	//000 F0 F4 F3 F2 F1 | F12-F5 | F20-F13 | F28-F21 | F36-F29 | ... | F68-F61 (69 bit)
+} XNetLocoState;
+
+#define XNetCVFree 0	//job is not used
+#define XNetCVWait 1	//wait for the sketch
+#define XNetCVRun 2		//the sketch read or write the CV
+#define XNetCVDone 3	//result is send, give it again when the throttle ask for it
+#define XNetCVNack 4	//no ACK
+#define XNetCVShort 5	//no ACK Short Circuit
+
+typedef struct	//CV programming job of one throttle
+{
+	uint8_t slot;		//DirectedOps of the throttle
+	uint8_t state;		//XNetCVFree, XNetCVWait, XNetCVRun, ...
+	bool write;			//write or read the CV
+	uint8_t cv;			//CV 0..255 like for notifyXNetDirectCV
+	uint8_t value;		//value to write or the result
+	unsigned long time;	//millis() of the request, the start or the result
+} XNetCVJob;
+
+typedef struct	//SLAVE MODE: loco request that wait for the answer
+{
+	uint16_t adr;		//loco address
+	uint8_t type;		//0x00 = loco info, 0x08 = functions F13-F28 (like the request 0xE3)
+	uint8_t retry;		//number of repeats
+} XNetSlaveReq;
+
+typedef struct	//statistics of one slot
+{
+	uint16_t calls;			//CallBytes send
+	uint16_t answers;		//pakets received with right XOR
+	uint16_t xorFails;		//pakets received with wrong XOR
+	uint16_t timeouts;		//windows without answer
+	uint16_t latencyMin;	//s from the CallByte to the first byte of the answer
+	uint16_t latencyAvg;
+	uint16_t latencyMax;
+} XNetSlotStats;
+
+typedef struct	//statistics of the bus
+{
+	XNetSlotStats slot[32];
+	uint16_t rxOverrun;		//pakets lost because the Read Buffer was full
+	uint16_t txOverrun;		//pakets lost because the Send Buffer was full
+	uint8_t busLoad;		//percent of the time with data on the bus since the last getStats()
+	unsigned long roundTime;	//s of the last round over all slots
+	unsigned long roundTimeMax;
+} XNetStats;
+
+typedef struct	//one trace entry
+{
+	uint16_t delta;		//s since the entry before, max 0xFFFF
+	uint16_t data;		//9 bit data and XNetTraceTX
+} XNetTraceEntry;
+
+#if defined(XNetTrntStore)
+static_assert((XNetTrntStore >= 4) && (XNetTrntStore <= 4096) && ((XNetTrntStore % 4) == 0), "XpressNet Turnout store must be a multiple of 4 (4..4096)");
+#endif
+
+#if defined(XNetTrace)
+static_assert((XNetTrace >= 2) && (XNetTrace <= 128) && ((XNetTrace & (XNetTrace - 1)) == 0), "XpressNet Trace size must be a power of two (2..128)");
+#endif
 
 // library interface description
 class XpressNetMasterClass
@@ -151,8 +393,13 @@ class XpressNetMasterClass
   // user-accessible "public" interface
   public:
     XpressNetMasterClass(void);	//Constuctor
-	#if defined(ESP8266) || defined(ESP32)
+	~XpressNetMasterClass(void);	//remove from the list of all bus
+	#if defined(XNetHardwareUART)
+	void setup(uint8_t FStufen, uint8_t XNetRxPin, uint8_t XNetTxPin, uint8_t XControl, bool XnModeAuto = true);  //Initialisierung UART, XControl = RTS
+	#elif defined(ESP8266) || defined(ESP32)
 	void setup(uint8_t FStufen, uint8_t XNetPort, uint8_t XControl, bool XnModeAuto = true);  //Initialisierung Serial
+	#elif defined(__AVR__)
+	void setup(uint8_t FStufen, uint8_t XControl, bool XnModeAuto = true, uint8_t UART = XNetUARTDefault);  //Initialisierung Serial, UART must be in XNetUARTs
 	#else
 	void setup(uint8_t FStufen, uint8_t XControl, bool XnModeAuto = true);  //Initialisierung Serial
 	#endif
@@ -167,9 +414,15 @@ class XpressNetMasterClass
 	void ReqLocoBusy(uint16_t Adr);	//Lok Adresse besetzt melden
 	void SetLocoBusy(uint8_t UserOps, uint16_t Adr);	//Lok besetzt melden
 	
+	#if defined(XNetSlaveSupport)
 	void getStatus();					//Staus der Zentrale erfragen
 	void getLocoInfo(uint16_t Adr);		//Slave Modus Lok Informationen erfragen!
 	void getLocoFkt(uint16_t Adr);		//Slave Modus Lok Funktionen erfragen!
+	void setSlaveAddress(uint8_t Adr);	//Slave Modus: device address 1..31, only this one
+	void addSlaveAddress(uint8_t Adr);	//Slave Modus: one more device in this instance
+	void setSlaveDevice(uint8_t Adr);	//Slave Modus: send the next pakets in the window of this device, 0 = any window
+	uint8_t getSlaveDevice(void);		//Slave Modus: device of the received paket, use it in the notify functions
+	#endif
 	
 	void SetLocoInfo(uint8_t UserOps, uint8_t Speed, uint8_t F0, uint8_t F1);	//Lokinfo an XNet Melden
 	void SetLocoInfo(uint8_t UserOps, uint8_t Steps, uint8_t Speed, uint8_t F0, uint8_t F1);	//Lokinfo an XNet Melden
@@ -182,30 +435,98 @@ class XpressNetMasterClass
 	void setFunc0to4(uint16_t Adr, uint8_t G1); //Gruppe 1: 0 0 0 F0 F4 F3 F2 F1
 	void setFunc5to8(uint16_t Adr, uint8_t G2); //Gruppe 2: 0 0 0 0 F8 F7 F6 F5 
 	void setFunc9to12(uint16_t Adr, uint8_t G3); //Gruppe 3: 0 0 0 0 F12 F11 F10 F9 
+	#if defined(XNetExtFunctions)
 	void setFunc13to20(uint16_t Adr, uint8_t G4); //Gruppe 4: F20 F19 F18 F17 F16 F15 F14 F13  
 	void setFunc21to28(uint16_t Adr, uint8_t G5); //Gruppe 5: F28 F27 F26 F25 F24 F23 F22 F21
+	#endif
+	void setFuncGroup(uint16_t Adr, uint8_t Group, uint8_t Bits); //Gruppe 1..10 (F0 to F68), with the loco cache only when it change
 
+	#if defined(XNetServiceMode)
 	void setCVReadValue(uint8_t cvAdr, uint8_t value);	//return a CV data read
 	void setCVNack(void);	//no ACK
 	void setCVNackSC(void); //no ACK Short Circuit
+	#endif
+
+	uint16_t getRXOverrun(void);	//pakets lost because the Read Buffer was full
+	uint16_t getTXOverrun(void);	//pakets lost because the Send Buffer was full
+	#if defined(XNetHardwareUART)
+	uint16_t getRXResync(void);	//pakets lost because the parity error was not for sure for one byte (ESP32)
+	#endif
+	unsigned long getPrioLatency(void);	//max time in s from setPower() until the paket starts on the bus
+	unsigned long timeUntilNextDeadline(void);	//s until update() must run again, 0 = now
+	#if defined(XNetPowerSave)
+	bool getPowerSave(void);	//slow polling is active
+	#endif
+	
+	#if defined(XNetTrace)
+	uint8_t readTrace(XNetTraceEntry *entries, uint8_t max);	//read out the trace, return number of entries
+	uint16_t getTraceLost(void);	//entries lost because the trace was full
+	#endif
+	void replayTrace(const XNetTraceEntry *entries, uint8_t count);	//put received data of a trace into the decoder
+	
+	#if defined(XNetStatistics)
+	void getStats(XNetStats *stats);	//copy the statistics and start a new bus load measure
+	void clearStats(void);	//reset all statistics
+	#endif
+	
+	#if defined(XNetFastClock)
+	void setFastClock(uint8_t Day, uint8_t Hour, uint8_t Minute, uint8_t Factor);	//Day 0..6 (Monday = 0), Factor 0 = stop, max 31
+	#endif
+	
+	#if defined(XNetTrntStore)
+	uint8_t getTrntPos(uint16_t Address);	//position of the turnout: 0 = unknown, 1 = straight (P=0), 2 = thrown (P=1)
+	void setTrntModules(uint16_t first, uint16_t count);	//modules (Address >> 2) of turnout decoders, answer them out of the store; default none
+	#endif
+	
+	#if defined(XNetLocoCache)
+	void clearLocoCache(uint16_t Adr = 0);	//remove loco from the cache, 0 = all
+	bool setFunc(uint16_t Adr, uint8_t F, bool on);	//switch one function F0..F68, send only its group; false = loco not in the cache
+	uint8_t getFuncGroup(uint16_t Adr, uint8_t Group);	//function group 1..10 of the cache, 0 = not in the cache
+	#endif
 	
 	// public only for easy access by interrupt handlers
-	static inline void handle_RX_interrupt();		//Serial RX Interrupt bearbeiten
-	static inline void handle_TX_interrupt();		//Serial TX Interrupt bearbeiten
+	template<uint8_t UART> static inline void handle_RX_interrupt();	//Serial RX Interrupt bearbeiten
+	template<uint8_t UART> static inline void handle_TX_interrupt();	//Serial TX Interrupt bearbeiten
+	#if defined(XNetHardwareUART)
+	static void handle_UART_interrupt(void *arg);	//ESP32 UART Interrupt bearbeiten
+	#elif defined(XNetHost)
+	static void handle_Host_interrupt(void *arg, uint16_t data9);	//simulated bus: received 9 bit data or XNetHostTXDone
+	#endif
 	
   // library-accessible "private" interface
   private:
 	  //Variables:
 	bool XModeAuto;		//ON = Automatische Umschaltung Master/Slave-Mode; OFF = Slave Mode only
+	#if defined(XNetSlaveSupport)
 	uint8_t XNetSlaveMode;	// > 0 then we are working in SLAVE MODE
+	volatile uint32_t XNetSlaveMask;	//SLAVE MODE: one bit for each device address of this instance
+	volatile uint8_t XNetSlaveCall;		//SLAVE MODE: device of the actual window
+	uint8_t XNetSlaveTag;	//SLAVE MODE: device of the next send pakets (0x40 | Adr), 0x00 = any
+	#else
+	static const uint8_t XNetSlaveMode = 0x00;	//MASTER MODE only, the compiler remove the SLAVE MODE parts
+	#endif
 	uint8_t XNetSlaveInit;	//send initialize sequence
 	byte Railpower;		//Data of the actual Power State
 	byte Fahrstufe;	//Standard fr Fahrstufe
 	byte MAX485_CONTROL; //Port for send or receive control
 	uint8_t XNetAdr;	//Adresse des Abzufragenden XNet Device
 	unsigned long XSendCount;	//Zeit: Call Byte ausgesendet, data received
+	volatile bool XNetWindowOpen;	//CallByte is out, wait for the first byte of the device
+	volatile unsigned long XNetWindowTime;	//Zeit: last CallByte is out on the bus
+	volatile bool XNetCallWait;	//CallByte is in the Send Buffer, wait until it is out
+	volatile bool XNetReplay;	//replayTrace() is running, nothing goes on the bus
+	#if defined(XNetPowerSave)
+	bool XNetPowerSaveOn;	//slow polling
+	unsigned long XNetPowerSaveTime;	//millis() of the last received paket
+	#endif
 	
-	XNetBuffer XNetRXBuffer;	//Read Buffer
+	XNetBuffer<XNetRXBufferSize> XNetRXBuffer;	//Read Buffer
+	uint16_t XNetRXOverrun;		//count lost pakets
+	#if defined(XNetHardwareUART)
+	uint16_t XNetRXResyncs;		//count lost pakets, 9th bit not known
+	bool XNetRXDrop;	//drop the data until the next CallByte
+	void XNetRXResync(void);	//9th bit of the waiting bytes not known, drop the running paket
+	#endif
 	
 	byte callByteParity (byte me);	// calculate the parity bit
 	uint8_t CallByteInquiry;
@@ -213,36 +534,200 @@ class XpressNetMasterClass
 	uint8_t DirectedOps;
 
 	uint16_t SlotLokUse[32];	//store loco to DirectedOps
-	void SetBusy(uint8_t Slot);	//send busy message to slot that doesn't use
-	void AddBusySlot(uint8_t UserOps, uint16_t Adr);	//add loco to slot
+	uint8_t SlotActivity[32];	//time x 100ms left that a slot is handled as active
+	uint8_t XNetActiveAdr;	//last slot that was called as active slot
+	uint8_t XNetActiveTurn;	//active windows since the last normal slot
+	uint8_t XNetRound;		//round counter for the discovery of unused slots
+	unsigned long XNetActiveTick;	//time of the last activity decrease
+	void AddBusySlot(uint8_t UserOps, uint16_t Adr);	//add loco to slot, send busy to the old slot
+	#if defined(XNetBusyTracker)
+	uint8_t XNetOwner[XNetOwnerSize];	//slot that use the loco in SlotLokUse, 0 = free
+	uint8_t XNetOwnerHash(uint16_t Adr);	//start position in the owner hash
+	uint8_t XNetOwnerPos(uint16_t Adr);		//position of the loco or free position
+	void XNetOwnerRemove(uint8_t pos);	//remove entry from the owner hash
+	void XNetOwnerRelease(uint8_t slot);	//remove the loco of the slot
+	#endif
 	
 	void XNetRXclear(uint8_t b);	//Clear a spezial RX Message
+	void XNetRXData(XNetMessage *msg, uint8_t data);	//add a data byte to the RX Message
+	uint8_t XNetRXXor;	//XOR of the paket while receive
+	uint8_t XNetRXNeed;	//length of the paket while receive (Header, data and XOR)
+	volatile uint8_t XNetRXSync;	//CallByte for the next RX Message (MASTER MODE)
 
 		//Functions:
 	void unknown(void);		//unbekannte Anfrage
 	void getNextXNetAdr(void);	//NCHSTE Adr of XNet Device
+	void XNetStartRound(void);	//begin a new round over all slots
+	bool XNetRXDecode(void);	//decode the next received paket, false = the Read Buffer is empty
 	bool XNetCheckXOR(void);	//Checks the XOR
 	void XNetAnalyseReceived(void);		//work on received data
 	
+		//Dispatch of received pakets:
+	XNetFrame XNetRX;	//actual received paket
+	static const XNetDispatch XNetMasterTable[];
+	#if defined(XNetSlaveSupport)
+	static const XNetDispatch XNetBroadcastTable[];	//SLAVE MODE
+	static const XNetDispatch XNetSlaveTable[];		//SLAVE MODE
+	#endif
+	bool XNetDispatchTable(const XNetDispatch *table, uint8_t count);	//call the handler
+	bool XNetFindEntry(const XNetDispatch *table, uint8_t count, uint8_t cmd, XNetDispatch *entry);
+	void XNetRxNone(uint8_t);
+	void XNetRxUnknown(uint8_t);
+	void XNetRxStatus(uint8_t);
+	void XNetRxVersion(uint8_t);
+	void XNetRxPower(uint8_t Power);
+	#if defined(XNetServiceMode)
+	void XNetRxCVResult(uint8_t);
+	void XNetRxCVRead(uint8_t);
+	void XNetRxCVWrite(uint8_t);
+	#endif
+	void XNetRxPOM(uint8_t);
+	void XNetRxLocoInfo(uint8_t);
+	void XNetRxFktMode(uint8_t Ident);
+	#if defined(XNetExtFunctions)
+	void XNetRxLocoFunc(uint8_t);
+	#endif
+	void XNetRxLocoMM(uint8_t);
+	void XNetRxLocoEmStop(uint8_t Long);
+	void XNetRxDrive(uint8_t Steps);
+	void XNetRxFunc(uint8_t Group);
+	void XNetRxTrntInfo(uint8_t Over1024);
+	void XNetRxTrnt(uint8_t Over1024);
+	#if defined(XNetSlaveSupport)
+	void XNetRxFeedback(uint8_t);
+	void XNetRxSlaveStatus(uint8_t);
+	void XNetRxSlaveVersion(uint8_t);
+	void XNetRxSlaveFkt(uint8_t);
+	void XNetRxSlaveLoco(uint8_t);
+	void XNetRxSlaveTrnt(uint8_t);
+	#endif
+	#if defined(XNetFastClock)
+	void XNetRxClock(uint8_t);
+	#if defined(XNetSlaveSupport)
+	void XNetRxSlaveClock(uint8_t);
+	#endif
+	uint8_t XNetClock[4];	//Minute, Hour, Day, Factor
+	unsigned long XNetClockNext;	//millis() of the next model minute
+	uint8_t XNetClockRest;	//rest of 60000 / Factor, so the ticks don't drift
+	bool XNetClockDue;	//send the clock in the next free window
+	void XNetClockStep(void);	//time of the next model minute
+	void XNetClockUpdate(void);	//count the model minutes
+	void XNetSendClock(uint8_t CallByte);	//send the fast clock
+	#endif
+	
 		//Serial send and receive:
 	#if defined(__AVR__)	
-	static XpressNetMasterClass *active_object;	//aktuelle aktive Object for interrupt handler	
+	static XpressNetMasterClass *active_object[XNetMaxUART];	//aktive Object of each UART for interrupt handler	
+	void (*XNetUARTWrite)(uint16_t data9);	//send on the UART of this object (XNetUSARTWrite<UART>)
+	#elif defined(XNetSoftwareSerial)
+	SoftwareSerial XNetSwSerial;	//One Wire Half Duplex Serial of this bus
 	#endif
 	
-	XNetBuffer XNetTXBuffer;
+	//all bus of this controller, they share the locos:
+	static XpressNetMasterClass *XNetFirstBus;
+	XpressNetMasterClass *XNetNextBus;
+	void XNetLocoTaken(uint16_t Adr, bool prio = false);	//the loco is now used on another bus or by the sketch
+	void XNetSendBusy(uint8_t UserOps, uint16_t Adr, bool prio);	//Lok besetzt melden, prio = before the Send Buffer
+	
+	XNetBuffer<XNetTXBufferSize> XNetTXBuffer;
+	uint16_t XNetTXOverrun;		//count lost pakets
 		
    	void XNetsend(byte *dataString, byte byteCount);	//Sende Datenarray out NOW!
+	void XNetsendFrame(uint8_t CallByte, const uint8_t *frame, byte byteCount);	//Sende cached frame out
+	XNetBuffer<XNetTXPrioSize> XNetTXPrio;	//priority Send Buffer
+	unsigned long XNetTXPrioTime[XNetTXPrioSize];	//time the paket was added
+	volatile unsigned long XNetPrioLatency;	//max time until a priority paket is send
+	void XNetsendPrio(uint8_t CallByte, const uint8_t *frame, byte byteCount);	//Sende cached frame with priority
+	uint8_t *XNetTXReservePrio(uint8_t CallByte);	//get the free priority message to write a paket, NULL = full
+	void XNetTXCommitPrio(byte byteCount);	//add the XOR and send the reserved priority message
+	void XNetTXPublishPrio(byte byteCount);	//publish the priority message to the transmission
+	XNetMessage XNetTXReply;	//answer of the receive interrupt in the actual window, send first
+	bool XNetsendReply(uint8_t CallByte, const uint8_t *frame, byte byteCount);	//Sende cached frame out of the receive interrupt
+	bool XNetFastAnswer(const XNetMessage *msg);	//answer stateless requests in the receive interrupt
+	void XNetTXReplyPublish(byte byteCount);	//publish the answer and start sending
+	XNetMessage *XNetTXMsg;	//message that is send out now, NULL = take the next one
+	bool XNetTXFull(bool CallByte = false);	//no free message in the Send Buffer
+	bool XNetTXReserve(bool CallByte = false);	//check for a free message in the Send Buffer
+	uint8_t XNetTXData(uint8_t pos);	//data byte of the actual send message
+	uint8_t *XNetTXReserveFrame(uint8_t CallByte);	//get the free message to write a paket, NULL = full
+	void XNetTXCommit(byte byteCount);	//add the XOR and send the reserved message
+	void XNetTXPublish(byte byteCount);	//publish the message to the transmission
+	void XNetSetLocoAdr(uint8_t *data, uint16_t Adr);	//write AH and AL of the loco
+	void XNetSendLocoFunc(uint16_t Adr, uint8_t Group, uint8_t Data);	//send a function group
+	void XNetSendFuncGroup(uint16_t Adr, uint8_t Group, uint8_t Bits);	//send function group 1..10
 	uint16_t XNetReadBuffer(void);	//read out next Buffer Data
+	XNetMessage *XNetTXNext(void);	//next paket of the Send Buffer, SLAVE MODE: for the actual window
 	void getXOR (uint8_t *data, byte length); // calculate the XOR
+	void XNetTXStart(void);		//start sending out the Buffer, if not already running
+	void XNetTXUnlock(void);	//the transmission is finished
+	volatile bool XNetTXBusy;	//the transmission is running
 	void XNetSendData(void);	//Sendet Daten aus dem Buffer mittels Interrupt
 	void XNetSendNext(void);	//Recursives sende weiterer Daten aus dem Buffer
+	uint16_t XNetTXLast;	//last 9 bit data that was send out
+	#if defined(XNetSoftwareSerial)
 	void XNetReceive(void);	//Speichern der eingelesenen Daten
+	#endif
+	void XNetRXWord(uint16_t data9);	//Speichern der eingelesenen 9 bit Daten
 	
-	uint16_t XNetCVAdr;		//CV Adr that was read
-	uint8_t XNetCVvalue;	//read CV Value 
+	#if (XNetFeedbackBuffer > 0)
+	uint8_t XNetFBData[XNetFeedbackBuffer][2];	//Adr and Data of the collected feedback
+	uint8_t XNetFBCount;	//collected feedback pairs
+	void XNetFeedbackFlush(void);	//send out the collected feedback
+	#endif
 	
-	uint16_t SlaveRequestLocoInfo = 0;		//Lok that we request for Lokdata
-	uint16_t SlaveRequestLocoFkt = 0;		//Lok that we request for Lok funktions
+	#if defined(XNetTrntStore)
+	uint8_t XNetTrnt[XNetTrntStore / 4];	//Z1 Z0 of 4 turnouts, one Byte for each decoder address (AAAA AAAA)
+	uint16_t XNetTrntFirst;	//first module of the turnout decoders
+	uint16_t XNetTrntCount;	//number of modules, 0 = answer all by notifyXNetTrntInfo
+	void XNetTrntSet(uint16_t Address, uint8_t P);	//save the position and broadcast the change
+	bool XNetTrntAnswer(const XNetMessage *msg);	//answer the information request in the receive interrupt
+	#endif
+	
+	#if defined(XNetLocoCache)
+	XNetLocoState XNetLocos[XNetLocoCache];	//Loco state cache
+	uint8_t XNetLocoNext;	//next entry to replace
+	XNetLocoState *XNetFindLoco(uint16_t Adr, bool add);	//search loco in the cache
+	void XNetCacheDrive(uint16_t Adr, uint8_t Steps, uint8_t Speed);	//save speed and direction
+	void XNetCacheFunc(uint16_t Adr, uint8_t Group, uint8_t Data);	//save function group
+	uint8_t XNetCacheGroup(const XNetLocoState *loco, uint8_t Group);	//read function group
+	#endif
+	
+	#if defined(XNetTrace)
+	XNetTraceEntry XNetTraceBuf[XNetTrace];	//trace ring
+	volatile uint8_t XNetTracePut;	//written by the receive and send
+	volatile uint8_t XNetTraceGet;	//written by readTrace()
+	unsigned long XNetTraceTime;	//time of the last entry
+	uint16_t XNetTraceLost;		//entries lost because the ring was full
+	void XNetTraceAdd(uint16_t data);	//add data to the trace
+	#endif
+	
+	#if defined(XNetStatistics)
+	XNetStats XNetStat;		//statistics
+	volatile unsigned long XNetStatBytes;	//bytes on the bus since the last getStats()
+	unsigned long XNetStatTime;		//time of the last getStats()
+	unsigned long XNetRoundTime;	//start of the actual round
+	#endif
+	
+	#if defined(XNetServiceMode)
+	XNetCVJob XNetCVList[XNetCVJobs];	//CV programming jobs
+	XNetCVJob *XNetCVActive;	//job of the sketch, NULL = the sketch is free
+	XNetCVJob *XNetCVFind(uint8_t slot, bool add);	//job of the throttle
+	void XNetCVRequest(bool write);	//new read or write request of the throttle in DirectedOps
+	void XNetCVUpdate(void);	//timeouts and give the next job to the sketch
+	void XNetCVFinish(uint8_t state, uint8_t value);	//result of the sketch
+	void XNetCVDeliver(XNetCVJob *job);	//send the result to the throttle
+	#endif
+	
+	#if defined(XNetSlaveSupport)
+	XNetSlaveReq XNetSlaveReqList[XNetSlaveRequests];	//SLAVE MODE: loco requests, the first is on the bus
+	uint8_t XNetSlaveReqCount;	//requests in the list
+	bool XNetSlaveReqSent;		//the first request is send, wait for the answer
+	unsigned long XNetSlaveReqTime;	//millis() of the send
+	void XNetSlaveReqAdd(uint16_t Adr, uint8_t type);	//add a request, only once for each loco
+	void XNetSlaveReqUpdate(void);	//send the next request, timeout and repeat
+	uint16_t XNetSlaveReqAdr(uint8_t type);	//loco of the answer, 0 = we don't wait for it
+	void XNetSlaveReqDone(void);	//answer received, remove the first request
+	#endif
 };
 
 #if defined (__cplusplus)
@@ -256,6 +741,7 @@ class XpressNetMasterClass
 	extern void notifyXNetLocoDrive27(uint16_t Address, uint8_t Speed) __attribute__((weak));
 	extern void notifyXNetLocoDrive28(uint16_t Address, uint8_t Speed) __attribute__((weak));
 	extern void notifyXNetLocoDrive128(uint16_t Address, uint8_t Speed) __attribute__((weak));
+	extern void notifyXNetLocoEmStop(uint16_t Address) __attribute__((weak));	//Nothalt fr eine Lok, stop it now!
 	//Funktionsbefehl:
 	extern void notifyXNetgiveLocoFunc(uint8_t UserOps, uint16_t Address) __attribute__((weak));
 	extern void notifyXNetLocoFunc1(uint16_t Address, uint8_t Func1) __attribute__((weak));//Gruppe1 0 0 0 F0 F4 F3 F2 F1
@@ -273,6 +759,10 @@ class XpressNetMasterClass
 	//POM:
 	extern void notifyXNetPOMwriteByte (uint16_t Adr, uint16_t CV, uint8_t data) __attribute__((weak));
 	extern void notifyXNetPOMwriteBit (uint16_t Adr, uint16_t CV, uint8_t data) __attribute__((weak));
+	//Fast Clock:
+	extern void notifyXNetFastClock(uint8_t Day, uint8_t Hour, uint8_t Minute, uint8_t Factor) __attribute__((weak));
+	//Idle time of the bus, work for max Budget s and come back to update():
+	extern void notifyXNetIdle(unsigned long Budget) __attribute__((weak));
 	//MultiMaus:
 	extern void notifyXNetgiveLocoMM(uint8_t UserOps, uint16_t Address) __attribute__((weak));	
 
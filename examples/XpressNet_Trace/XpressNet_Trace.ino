@@ -0,0 +1,89 @@
+/*
+  XpressNet Trace
+  Record all data on the XpressNet bus in binary to the Serial,
+  or replay a recorded trace into the decoder.
+
+  Enable '#define XNetTrace' inside XpressNetMaster.h!
+
+  Record: the Serial sends "XNT1" and then each entry with 4 Byte
+          (delta time in us and data, see XNetTraceEntry), save it on the PC into a file.
+  Replay: send the file back to the Serial, the received pakets of the trace
+          run through the decoder and the notify functions.
+          The Master don't poll and send nothing while replay, disconnect the Bus.
+          On the PC: extras/host/XNetReplay.cpp
+*/
+
+#include <XpressNetMaster.h>
+XpressNetMasterClass XpressNet;
+
+//#define REPLAY    //replay a trace, without: record
+
+#define TraceSpeed 500000   //fast enough for a full XpressNet
+
+XNetTraceEntry entries[16];
+
+void setup() {
+  Serial.begin(TraceSpeed);
+
+  #if defined(ESP8266)
+  XpressNet.setup(Loco128, D6, D0);    //Initialisierung XNet Serial, RX/TX-PIN, Send/Receive-PIN  
+  #else
+  XpressNet.setup(Loco128, 9);    //Initialisierung XNet Serial und Send/Receive-PIN  
+  #endif
+
+  #if !defined(REPLAY)
+  Serial.write("XNT1");  //file header
+  #else
+  //wait for the file header:
+  uint8_t found = 0;
+  while (found < 4) {
+    if (Serial.available() && Serial.read() == "XNT1"[found])
+      found++;
+  }
+  #endif
+}
+
+void loop() {
+  #if !defined(REPLAY)
+  XpressNet.update();   //call in every loop
+
+  uint8_t count = XpressNet.readTrace(entries, 16);
+  for (uint8_t i = 0; i < count; i++) {
+    Serial.write(lowByte(entries[i].delta));
+    Serial.write(highByte(entries[i].delta));
+    Serial.write(lowByte(entries[i].data));
+    Serial.write(highByte(entries[i].data));
+  }
+  #else
+  if (Serial.available() >= 4) {
+    entries[0].delta = Serial.read();
+    entries[0].delta |= Serial.read() << 8;
+    entries[0].data = Serial.read();
+    entries[0].data |= Serial.read() << 8;
+    XpressNet.replayTrace(entries, 1);  //no update(), it would poll the bus
+  }
+  #endif
+}
+
+#if defined(REPLAY)
+//--------------------------------------------------------------
+//the decoded pakets of the trace:
+void notifyXNetPower(uint8_t State) {
+  Serial.print("Power: ");
+  Serial.println(State, HEX);
+}
+
+void notifyXNetLocoDrive128(uint16_t Address, uint8_t Speed) {
+  Serial.print("XNet A:");
+  Serial.print(Address);
+  Serial.print(", S128:");
+  Serial.println(Speed, BIN);
+}
+
+void notifyXNetTrnt(uint16_t Address, uint8_t data) {
+  Serial.print("XNet TA:");
+  Serial.print(Address);
+  Serial.print(", P:");
+  Serial.println(data, BIN);
+}
+#endif
@@ -0,0 +1,42 @@
+/*
+  Arduino.h - minimal Arduino core for the host build of the XpressNetMaster library
+
+  Only what the library needs, the time is the virtual time of the simulated bus
+  (see XNetHostBus.h). No hardware, no Serial.
+*/
+
+#ifndef XNetHost_Arduino_h
+#define XNetHost_Arduino_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef uint8_t byte;
+inline uint16_t word(uint8_t h, uint8_t l) { return (h << 8) | l; }
+#define lowByte(w) ((uint8_t)((w) & 0xff))
+#define highByte(w) ((uint8_t)((w) >> 8))
+
+#define B11 3
+#define B110 6
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define HEX 16
+#define DEC 10
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define memcpy_P memcpy
+
+extern unsigned long XNetHostMicros;	//virtual time in us
+
+inline unsigned long micros(void) { return XNetHostMicros; }
+inline unsigned long millis(void) { return XNetHostMicros / 1000; }
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}	//MAX485 direction, the simulated bus don't need it
+
+#endif
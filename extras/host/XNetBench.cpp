@@ -0,0 +1,197 @@
+/*
+  XNetBench.cpp - throughput benchmarks of the XpressNetMaster library on the host
+
+  Runs the master in MASTER MODE on the simulated bus (XNetHostBus) with virtual
+  throttles, all in virtual time, so the numbers only depend on the library.
+
+  Build and run from the library folder (Linux, g++):
+    g++ -O2 -std=gnu++11 -DARDUINO=100 -DXNetHost -Iextras/host -I. \
+        XpressNetMaster.cpp extras/host/XNetHostBus.cpp extras/host/XNetBench.cpp -o xnetbench
+    ./xnetbench
+
+  Output for each scenario:
+    cmd/s      commands that reach the notifyXNet* functions, per second of bus time
+    p50, p99   latency in us from the throttle wants to send until the notify (CV: until the answer)
+    lost       commands replaced at the throttle before they get a window
+    drop       lost inside the master: RX + TX Buffer overrun, XOR fails, not decoded
+    coll       master and throttle send at the same time
+    ns/paket   wall clock time of update() that decode a paket (depends on the PC!)
+*/
+
+#include "XNetHostBus.h"
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+
+#define XNetBenchTime 10000000UL	//10 sec bus time for each scenario
+#define XNetBenchLoco 1000		//loco address of the throttle in slot 1, long address
+
+struct XNetBenchScenario {
+	const char *name;
+	uint8_t throttles;		//on slot 1..n
+	unsigned long interval;	//us between two commands of a throttle
+	uint8_t feedback;		//feedback modules that change each XNetBenchFBTime
+	bool cv;				//slot 1 reads CV in a loop
+};
+
+static const XNetBenchScenario XNetBenchScenarios[] = {
+	{ "drive, 4 throttles",  4, 20000, 0, false },
+	{ "drive, 31 throttles", 31, 50000, 0, false },
+	{ "drive overload",      31, 20000, 0, false },
+	{ "feedback flood",      4, 50000, 32, false },
+	{ "CV read",             1, 0, 0, true },
+};
+#define XNetBenchFBTime 10000	//us between feedback changes
+#define XNetBenchCVTime 5000	//us the sketch needs to read a CV
+
+static XpressNetMasterClass *XNet = NULL;
+static const XNetBenchScenario *XNetBenchNow = NULL;
+static unsigned long XNetBenchNext[XNetHostSlots];	//time for the next command
+static unsigned long XNetBenchQueued[XNetHostSlots];	//time the command waits
+static uint8_t XNetBenchSpeed[XNetHostSlots];
+static std::vector<unsigned long> XNetBenchLatency;
+static unsigned long XNetBenchDone = 0;
+static unsigned long XNetBenchRand = 1;
+static unsigned long XNetBenchFB = 0;	//time for the next feedback change
+static uint8_t XNetBenchFBState = 0;
+static unsigned long XNetBenchCVAnswer = 0;	//time the sketch answers the CV, 0 = nothing
+static uint16_t XNetBenchCV = 0;
+static bool XNetBenchCVRead = false;	//throttle wait for the CV result
+
+//--------------------------------------------------------------------------------------------
+static unsigned long XNetBenchRandom(unsigned long max) {
+	XNetBenchRand = XNetBenchRand * 1103515245UL + 12345UL;	//same sequence on each run
+	return ((XNetBenchRand >> 8) & 0xFFFFFF) % max;
+}
+
+//--------------------------------------------------------------------------------------------
+static void XNetBenchDrive(uint8_t slot) {
+	uint16_t adr = XNetBenchLoco + slot;
+	XNetBenchSpeed[slot] = (XNetBenchSpeed[slot] + 1) & 0x7F;
+	uint8_t data[] = { 0xE4, 0x13, (uint8_t)(0xC0 | (adr >> 8)), (uint8_t)(adr & 0xFF), (uint8_t)(0x80 | XNetBenchSpeed[slot]) };
+	XNetHostQueue(slot, data, sizeof(data));
+	XNetBenchQueued[slot] = micros();
+}
+
+//--------------------------------------------------------------------------------------------
+static void XNetBenchCVStart(void) {
+	XNetBenchCV = (XNetBenchCV % 255) + 1;
+	uint8_t data[] = { 0x22, 0x15, (uint8_t)XNetBenchCV };
+	XNetHostQueue(1, data, sizeof(data));
+	XNetBenchQueued[1] = micros();
+	XNetBenchCVRead = true;
+}
+
+//--------------------------------------------------------------------------------------------
+static void XNetBenchDone1(unsigned long queued) {
+	XNetBenchLatency.push_back(micros() - queued);
+	XNetBenchDone++;
+}
+
+//--------------------------------------------------------------------------------------------
+//the sketch loop()
+static void XNetBenchLoop(void) {
+	unsigned long now = micros();
+	if (XNetBenchNow->interval > 0) {
+		for (uint8_t slot = 1; slot <= XNetBenchNow->throttles; slot++) {
+			if ((long)(now - XNetBenchNext[slot]) >= 0) {
+				XNetBenchNext[slot] += XNetBenchNow->interval;
+				XNetBenchDrive(slot);
+			}
+		}
+	}
+	if (XNetBenchNow->feedback > 0 && (long)(now - XNetBenchFB) >= 0) {
+		XNetBenchFB += XNetBenchFBTime;
+		XNetBenchFBState++;
+		for (uint8_t m = 0; m < XNetBenchNow->feedback; m++) {
+			XNet->setBCFeedback(m, 0x40 | (XNetBenchFBState & 0x0F));	//lower nibble
+			XNet->setBCFeedback(m, 0x50 | (XNetBenchFBState & 0x0F));	//upper nibble
+		}
+	}
+	if (XNetBenchNow->cv) {
+		if (XNetBenchCVAnswer != 0 && (long)(now - XNetBenchCVAnswer) >= 0) {
+			XNetBenchCVAnswer = 0;
+			XNet->setCVReadValue(XNetBenchCV - 1, XNetBenchCV);
+		}
+		if (!XNetHostPending(1)) {
+			if (!XNetBenchCVRead)
+				XNetBenchCVStart();
+			else {	//ask for the result in each window
+				uint8_t data[] = { 0x21, 0x10 };
+				XNetHostQueue(1, data, sizeof(data));
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+static void XNetBenchReply(uint8_t slot, const uint8_t *data, uint8_t /*len*/, bool broadcast) {
+	if (XNetBenchNow->cv && XNetBenchCVRead && !broadcast && slot == 1 && data[0] == 0x63 && data[1] == 0x14 && data[2] == (uint8_t)XNetBenchCV) {
+		XNetBenchDone1(XNetBenchQueued[1]);
+		XNetBenchCVRead = false;
+		XNetHostCancel(1);	//no more asking for the result
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//notify of the master:
+void notifyXNetLocoDrive128(uint16_t Address, uint8_t /*Speed*/) {
+	uint16_t slot = Address - XNetBenchLoco;
+	if (slot > 0 && slot < XNetHostSlots)
+		XNetBenchDone1(XNetBenchQueued[slot]);
+}
+
+void notifyXNetDirectReadCV(uint16_t /*cvAdr*/) {
+	XNetBenchCVAnswer = micros() + XNetBenchCVTime;
+}
+
+//--------------------------------------------------------------------------------------------
+static unsigned long XNetBenchPercentile(std::vector<unsigned long> &v, unsigned int p) {
+	if (v.empty())
+		return 0;
+	size_t pos = (v.size() - 1) * p / 100;
+	std::nth_element(v.begin(), v.begin() + pos, v.end());
+	return v[pos];
+}
+
+//--------------------------------------------------------------------------------------------
+static void XNetBenchRun(const XNetBenchScenario *s) {
+	XpressNetMasterClass master;
+	XNet = &master;
+	XNetBenchNow = s;
+	XNetBenchLatency.clear();
+	XNetBenchDone = 0;
+	XNetBenchRand = 1;
+	XNetBenchFB = micros();
+	XNetBenchCVAnswer = 0;
+	XNetBenchCVRead = false;
+	for (uint8_t slot = 0; slot < XNetHostSlots; slot++) {
+		XNetBenchSpeed[slot] = 0;
+		XNetBenchNext[slot] = micros() + (s->interval > 0 ? XNetBenchRandom(s->interval) : 0);
+	}
+
+	XNetHostBegin(&master, s->throttles);
+	master.setup(Loco128, 0);	//MAX485 control pin is not used
+	master.setPower(csNormal);
+	XNetHostOnReply = XNetBenchReply;
+	XNetHostRun(XNetBenchTime, XNetBenchLoop);
+
+	unsigned long inMaster = XNetHostCount.sent;	//every send paket must reach notify
+	unsigned long drop = master.getRXOverrun() + master.getTXOverrun() + XNetHostCount.xorFails;
+	if (!s->cv && inMaster > XNetBenchDone + s->throttles)
+		drop += inMaster - XNetBenchDone - s->throttles;	//the last ones may be still in the Buffer
+	double ns = XNetHostCount.decodes ? XNetHostCount.decodeNs / XNetHostCount.decodes : 0;
+
+	printf("%-20s %8.1f %8lu %8lu %7lu %7lu %7lu %9.0f\n", s->name,
+		XNetBenchDone / (XNetBenchTime / 1000000.0),
+		XNetBenchPercentile(XNetBenchLatency, 50), XNetBenchPercentile(XNetBenchLatency, 99),
+		XNetHostCount.replaced, drop, XNetHostCount.collisions, ns);
+}
+
+//--------------------------------------------------------------------------------------------
+int main(void) {
+	printf("%-20s %8s %8s %8s %7s %7s %7s %9s\n", "scenario", "cmd/s", "p50 us", "p99 us", "lost", "drop", "coll", "ns/paket");
+	for (size_t i = 0; i < sizeof(XNetBenchScenarios) / sizeof(XNetBenchScenarios[0]); i++)
+		XNetBenchRun(&XNetBenchScenarios[i]);
+	return 0;
+}
@@ -0,0 +1,175 @@
+/*
+  XNetHostBus.cpp - simulated XpressNet bus for the host build
+*/
+
+#include "XNetHostBus.h"
+#include <queue>
+#include <vector>
+#include <chrono>
+
+unsigned long XNetHostMicros = 0;	//virtual time, read by micros()
+XNetHostCounters XNetHostCount;
+XNetHostReplyFunc XNetHostOnReply = NULL;
+
+enum XNetHostKind { XNetHostMasterByte, XNetHostThrottleByte };
+
+struct XNetHostEvent {
+	unsigned long time;	//end of the byte on the bus
+	unsigned long seq;	//same time: first in, first out
+	XNetHostKind kind;
+	uint16_t data9;
+	bool operator>(const XNetHostEvent &e) const { return (time != e.time) ? (time > e.time) : (seq > e.seq); }
+};
+
+struct XNetHostThrottle {
+	bool pending;
+	uint8_t len;
+	uint8_t data[XNetBufferMaxData];
+};
+
+static XpressNetMasterClass *XNetHostMaster = NULL;
+static std::priority_queue<XNetHostEvent, std::vector<XNetHostEvent>, std::greater<XNetHostEvent> > XNetHostEvents;
+static unsigned long XNetHostSeq = 0;
+static unsigned long XNetHostBusFree = 0;	//end of the last byte on the bus
+static uint8_t XNetHostThrottles = 0;
+static XNetHostThrottle XNetHostThr[XNetHostSlots];
+
+//receive state of the throttles for the paket from the master:
+static int8_t XNetHostRxSlot = -1;	//-1 = no paket for a throttle
+static uint8_t XNetHostRxLen = 0;
+static uint8_t XNetHostRxData[XNetBufferMaxData];
+
+//--------------------------------------------------------------------------------------------
+static void XNetHostPush(unsigned long time, XNetHostKind kind, uint16_t data9) {
+	XNetHostEvent e = { time, XNetHostSeq++, kind, data9 };
+	XNetHostEvents.push(e);
+}
+
+//--------------------------------------------------------------------------------------------
+void XNetHostBegin(XpressNetMasterClass *master, uint8_t throttles) {
+	XNetHostMaster = master;
+	XNetHostThrottles = (throttles > XNetHostSlots - 1) ? XNetHostSlots - 1 : throttles;
+	while (!XNetHostEvents.empty())
+		XNetHostEvents.pop();
+	memset(&XNetHostCount, 0, sizeof(XNetHostCount));
+	memset(XNetHostThr, 0, sizeof(XNetHostThr));
+	XNetHostBusFree = XNetHostMicros;
+	XNetHostRxSlot = -1;
+}
+
+//--------------------------------------------------------------------------------------------
+bool XNetHostQueue(uint8_t slot, const uint8_t *data, uint8_t len) {
+	if (slot == 0 || slot > XNetHostThrottles || len + 1 > XNetBufferMaxData)
+		return false;
+	XNetHostThrottle *t = &XNetHostThr[slot];
+	bool replaced = t->pending;
+	if (replaced)
+		XNetHostCount.replaced++;
+	uint8_t x = 0;
+	for (uint8_t i = 0; i < len; i++) {
+		t->data[i] = data[i];
+		x ^= data[i];
+	}
+	t->data[len] = x;
+	t->len = len + 1;
+	t->pending = true;
+	return !replaced;
+}
+
+//--------------------------------------------------------------------------------------------
+bool XNetHostPending(uint8_t slot) {
+	return (slot < XNetHostSlots) && XNetHostThr[slot].pending;
+}
+
+//--------------------------------------------------------------------------------------------
+void XNetHostCancel(uint8_t slot) {
+	if (slot < XNetHostSlots)
+		XNetHostThr[slot].pending = false;
+}
+
+//--------------------------------------------------------------------------------------------
+//the master library send out the next 9 bit data
+void XNetHostWrite(uint16_t data9) {
+	unsigned long start = XNetHostMicros;
+	if ((long)(XNetHostBusFree - start) > 0)
+		XNetHostCount.collisions++;	//a throttle is still sending
+	XNetHostBusFree = start + XNetHostWordTime;
+	XNetHostPush(XNetHostBusFree, XNetHostMasterByte, data9);
+}
+
+//--------------------------------------------------------------------------------------------
+//the throttles read a byte of the master
+static void XNetHostThrottleRead(uint16_t data9) {
+	if (data9 & 0x100) {	//CallByte
+		uint8_t call = data9 & 0x7F;	//without parity
+		uint8_t slot = call & 0x1F;
+		XNetHostRxSlot = -1;
+		if ((call & 0x60) == 0x60)	//directed or broadcast (slot 0) paket follows
+			XNetHostRxSlot = slot;
+		else if (((call & 0x60) == 0x40) && (slot > 0) && (slot <= XNetHostThrottles)) {	//inquiry
+			XNetHostCount.windows++;
+			XNetHostThrottle *t = &XNetHostThr[slot];
+			if (t->pending) {	//answer in the window
+				unsigned long time = XNetHostMicros + XNetHostReplyDelay;
+				for (uint8_t i = 0; i < t->len; i++) {
+					time += XNetHostWordTime;
+					XNetHostPush(time, XNetHostThrottleByte, t->data[i]);
+				}
+				XNetHostBusFree = time;
+				t->pending = false;
+				XNetHostCount.sent++;
+			}
+		}
+		XNetHostRxLen = 0;
+		return;
+	}
+	if (XNetHostRxSlot < 0 || XNetHostRxLen >= XNetBufferMaxData)
+		return;
+	XNetHostRxData[XNetHostRxLen++] = data9;
+	if (XNetHostRxLen < 2 || XNetHostRxLen != (XNetHostRxData[0] & 0x0F) + 2)
+		return;
+	uint8_t x = 0;	//paket complete
+	for (uint8_t i = 0; i < XNetHostRxLen; i++)
+		x ^= XNetHostRxData[i];
+	if (x != 0)
+		XNetHostCount.xorFails++;
+	else {
+		XNetHostCount.received++;
+		if (XNetHostOnReply)
+			XNetHostOnReply(XNetHostRxSlot, XNetHostRxData, XNetHostRxLen, XNetHostRxSlot == 0);
+	}
+	XNetHostRxSlot = -1;
+}
+
+//--------------------------------------------------------------------------------------------
+//all "interrupts" until the time
+static void XNetHostInterrupts(unsigned long until) {
+	while (!XNetHostEvents.empty() && (long)(XNetHostEvents.top().time - until) <= 0) {
+		XNetHostEvent e = XNetHostEvents.top();
+		XNetHostEvents.pop();
+		XNetHostMicros = e.time;
+		if (e.kind == XNetHostMasterByte) {
+			XNetHostThrottleRead(e.data9);
+			XpressNetMasterClass::handle_Host_interrupt(XNetHostMaster, XNetHostTXDone);
+		}
+		else XpressNetMasterClass::handle_Host_interrupt(XNetHostMaster, e.data9);
+	}
+	XNetHostMicros = until;
+}
+
+//--------------------------------------------------------------------------------------------
+void XNetHostRun(unsigned long time, void (*loop)(void)) {
+	unsigned long end = XNetHostMicros + time;
+	while ((long)(end - XNetHostMicros) > 0) {
+		XNetHostInterrupts(XNetHostMicros + XNetHostLoopTime);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool work = XNetHostMaster->update();
+		if (work) {
+			std::chrono::duration<double, std::nano> ns = std::chrono::steady_clock::now() - start;
+			XNetHostCount.decodes++;
+			XNetHostCount.decodeNs += ns.count();
+		}
+		if (loop)
+			loop();
+	}
+}
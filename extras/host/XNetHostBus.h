@@ -0,0 +1,44 @@
+/*
+  XNetHostBus.h - simulated XpressNet bus for the host build
+
+  One master (XpressNetMasterClass compiled with -DXNetHost) and virtual throttles
+  on the slots 1..31. Everything runs in virtual time: each 9 bit byte takes
+  XNetHostWordTime on the bus, a throttle starts its answer XNetHostReplyDelay
+  after its CallByte and one loop() of the sketch takes XNetHostLoopTime.
+  The same input gives the same result on each PC.
+*/
+
+#ifndef XNetHostBus_h
+#define XNetHostBus_h
+
+#include "XpressNetMaster.h"
+
+#define XNetHostSlots 32		//slot 0 is the broadcast
+#define XNetHostWordTime 176	//11 bit at 62.5 kBaud
+#define XNetHostReplyDelay 60	//throttle start to send after the CallByte (XpressNet: max 110)
+#define XNetHostLoopTime 20		//virtual time of one loop() with update()
+
+struct XNetHostCounters {
+	unsigned long windows;		//CallBytes for a throttle
+	unsigned long sent;			//pakets send by the throttles
+	unsigned long received;		//pakets the throttles received (directed and broadcast)
+	unsigned long replaced;		//throttle paket replaced before its window
+	unsigned long collisions;	//master and throttle send at the same time
+	unsigned long xorFails;		//pakets from the master with a bad XOR
+	unsigned long decodes;		//update() that work on a paket
+	double decodeNs;			//wall clock time inside these update()
+};
+
+//paket from the master (with XOR) to a throttle, broadcast = all throttles
+typedef void (*XNetHostReplyFunc)(uint8_t slot, const uint8_t *data, uint8_t len, bool broadcast);
+
+extern XNetHostCounters XNetHostCount;
+extern XNetHostReplyFunc XNetHostOnReply;
+
+void XNetHostBegin(XpressNetMasterClass *master, uint8_t throttles);	//reset the bus, throttles on slot 1..throttles
+bool XNetHostQueue(uint8_t slot, const uint8_t *data, uint8_t len);	//paket without XOR for the next window, false = replaced the waiting one
+bool XNetHostPending(uint8_t slot);	//paket still waiting for the window
+void XNetHostCancel(uint8_t slot);	//throttle don't send the waiting paket (not counted as replaced)
+void XNetHostRun(unsigned long time, void (*loop)(void));	//run update(), loop() and the bus for time us
+
+#endif
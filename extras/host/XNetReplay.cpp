@@ -0,0 +1,176 @@
+/*
+  XNetReplay.cpp - replay a recorded bus trace into the XpressNetMaster library on the host
+
+  Reads a trace file ("XNT1" and 4 Byte entries, see XNetTraceEntry and the
+  XpressNet_Trace example), puts it with replayTrace() into the decoder and
+  prints the notifyXNet* calls. The master don't poll and send nothing, the
+  slot of each paket comes from the recorded CallByte.
+
+  Build and run from the library folder (Linux, g++):
+    g++ -O2 -std=gnu++11 -DARDUINO=100 -DXNetHost -Iextras/host -I. \
+        XpressNetMaster.cpp extras/host/XNetHostBus.cpp extras/host/XNetReplay.cpp -o xnetreplay
+    ./xnetreplay trace.xnt
+*/
+
+#include "XNetHostBus.h"
+#include <stdio.h>
+#include <string.h>
+
+#define XNetReplayChunk 64	//entries for each replayTrace()
+
+static unsigned long XNetReplayStart = 0;	//virtual time of the first entry
+
+//--------------------------------------------------------------------------------------------
+static void XNetReplayTime(void) {
+	printf("%10lu ", micros() - XNetReplayStart);
+}
+
+//--------------------------------------------------------------------------------------------
+//notify of the master:
+void notifyXNetPower(uint8_t State) {
+	XNetReplayTime();
+	printf("Power: 0x%02X\n", State);
+}
+
+void notifyXNetgiveLocoInfo(uint8_t UserOps, uint16_t Address) {
+	XNetReplayTime();
+	printf("slot %2u: Loco info A:%u\n", UserOps & 0x1F, Address);
+}
+
+void notifyXNetLocoDrive14(uint16_t Address, uint8_t Speed) {
+	XNetReplayTime();
+	printf("Loco A:%u S14:0x%02X\n", Address, Speed);
+}
+
+void notifyXNetLocoDrive27(uint16_t Address, uint8_t Speed) {
+	XNetReplayTime();
+	printf("Loco A:%u S27:0x%02X\n", Address, Speed);
+}
+
+void notifyXNetLocoDrive28(uint16_t Address, uint8_t Speed) {
+	XNetReplayTime();
+	printf("Loco A:%u S28:0x%02X\n", Address, Speed);
+}
+
+void notifyXNetLocoDrive128(uint16_t Address, uint8_t Speed) {
+	XNetReplayTime();
+	printf("Loco A:%u S128:0x%02X\n", Address, Speed);
+}
+
+void notifyXNetLocoEmStop(uint16_t Address) {
+	XNetReplayTime();
+	printf("Loco A:%u EmStop\n", Address);
+}
+
+void notifyXNetgiveLocoFunc(uint8_t UserOps, uint16_t Address) {
+	XNetReplayTime();
+	printf("slot %2u: Loco func A:%u\n", UserOps & 0x1F, Address);
+}
+
+void notifyXNetLocoFunc1(uint16_t Address, uint8_t Func1) {
+	XNetReplayTime();
+	printf("Loco A:%u F0-F4:0x%02X\n", Address, Func1);
+}
+
+void notifyXNetLocoFunc2(uint16_t Address, uint8_t Func2) {
+	XNetReplayTime();
+	printf("Loco A:%u F5-F8:0x%02X\n", Address, Func2);
+}
+
+void notifyXNetLocoFunc3(uint16_t Address, uint8_t Func3) {
+	XNetReplayTime();
+	printf("Loco A:%u F9-F12:0x%02X\n", Address, Func3);
+}
+
+void notifyXNetLocoFuncX(uint16_t Address, uint8_t group, uint8_t Func) {
+	XNetReplayTime();
+	printf("Loco A:%u group %u:0x%02X\n", Address, group, Func);
+}
+
+void notifyXNetTrntInfo(uint8_t UserOps, uint16_t Address, uint8_t data) {
+	XNetReplayTime();
+	printf("slot %2u: Trnt info A:%u N:%u\n", UserOps & 0x1F, Address, data);
+}
+
+void notifyXNetTrnt(uint16_t Address, uint8_t data) {
+	XNetReplayTime();
+	printf("Trnt A:%u P:0x%02X\n", Address, data);
+}
+
+void notifyXNetFeedback(uint16_t Address, uint8_t data) {
+	XNetReplayTime();
+	printf("Feedback A:%u D:0x%02X\n", Address, data);
+}
+
+void notifyXNetDirectCV(uint16_t CV, uint8_t data) {
+	XNetReplayTime();
+	printf("CV write %u:%u\n", CV, data);
+}
+
+void notifyXNetDirectReadCV(uint16_t cvAdr) {
+	XNetReplayTime();
+	printf("CV read %u\n", cvAdr);
+}
+
+void notifyXNetPOMwriteByte(uint16_t Adr, uint16_t CV, uint8_t data) {
+	XNetReplayTime();
+	printf("POM A:%u CV %u:%u\n", Adr, CV, data);
+}
+
+void notifyXNetPOMwriteBit(uint16_t Adr, uint16_t CV, uint8_t data) {
+	XNetReplayTime();
+	printf("POM A:%u CV %u bit:0x%02X\n", Adr, CV, data);
+}
+
+void notifyXNetgiveLocoMM(uint8_t UserOps, uint16_t Address) {
+	XNetReplayTime();
+	printf("slot %2u: Loco MM A:%u\n", UserOps & 0x1F, Address);
+}
+
+//--------------------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s trace.xnt\n", argv[0]);
+		return 2;
+	}
+	FILE *f = fopen(argv[1], "rb");
+	if (f == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+	char head[4];
+	if (fread(head, 1, 4, f) != 4 || memcmp(head, "XNT1", 4) != 0) {
+		fprintf(stderr, "%s: no XNT1 trace\n", argv[1]);
+		fclose(f);
+		return 1;
+	}
+
+	XpressNetMasterClass master;
+	XNetHostBegin(&master, 0);	//no throttles, the master don't send
+	master.setup(Loco128, 0);	//MAX485 control pin is not used
+	XNetReplayStart = micros();
+
+	XNetTraceEntry entries[XNetReplayChunk];
+	unsigned long total = 0;
+	uint8_t raw[4];
+	uint8_t count = 0;
+	for (;;) {
+		bool end = (fread(raw, 1, 4, f) != 4);
+		if (!end) {
+			entries[count].delta = raw[0] | (raw[1] << 8);	//little endian
+			entries[count].data = raw[2] | (raw[3] << 8);
+			count++;
+		}
+		if (count == XNetReplayChunk || (end && count > 0)) {
+			master.replayTrace(entries, count);
+			total += count;
+			count = 0;
+		}
+		if (end)
+			break;
+	}
+	fclose(f);
+
+	printf("%lu entries, %lu us, RX overrun %u\n", total, micros() - XNetReplayStart, master.getRXOverrun());
+	return 0;
+}